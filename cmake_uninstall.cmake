@@ -3,8 +3,13 @@
 if(NOT DEFINED CMAKE_INSTALL_PREFIX)
     set(CMAKE_INSTALL_PREFIX "/usr/local")
 endif()
-message(STATUS "Uninstalling diff-numerics and man page from ${CMAKE_INSTALL_PREFIX}")
+message(STATUS "Uninstalling diff-numerics, libdiffnumerics, headers and man page from ${CMAKE_INSTALL_PREFIX}")
 file(REMOVE "${CMAKE_INSTALL_PREFIX}/bin/diff-numerics")
+file(GLOB DIFFNUMERICS_LIBRARIES "${CMAKE_INSTALL_PREFIX}/lib/libdiffnumerics.so*")
+if(DIFFNUMERICS_LIBRARIES)
+    file(REMOVE ${DIFFNUMERICS_LIBRARIES})
+endif()
+file(REMOVE_RECURSE "${CMAKE_INSTALL_PREFIX}/include/diff-numerics")
 file(REMOVE "${CMAKE_INSTALL_PREFIX}/share/man/man1/diff-numerics.1")
 execute_process(COMMAND mandb)
 message(STATUS "Uninstall complete.")
@@ -0,0 +1,64 @@
+// ArrayFile.h
+// -------------------------------------------------------------
+// This header defines the ArrayFile class, a read-only, memory-mapped view
+// of a binary array of doubles, used to compare binary inputs without any
+// text conversion or parsing.
+//
+// Supported formats:
+// - NumPy .npy files holding little-endian float64 ('<f8') data in C order,
+//   with shape (rows,), (rows, columns) or () (a single value)
+// - Raw little-endian float64 arrays, with a user-given number of columns
+//
+// ArrayView is the strided view the comparison works on; it also describes
+// arrays owned by a caller of the C API (e.g. Fortran column-major arrays).
+// -------------------------------------------------------------
+
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only view of a rows x columns array of doubles; strides are in elements
+struct ArrayView {
+    const double* data = nullptr;
+    size_t rows = 0;
+    size_t columns = 0;
+    size_t row_stride = 0;     // Between consecutive rows (C order: columns)
+    size_t column_stride = 1;  // Between consecutive columns (C order: 1, Fortran order: rows)
+
+    double at(size_t i, size_t j) const { return data[i * row_stride + j * column_stride]; }
+};
+
+class ArrayFile {
+public:
+    enum class Format { Text, Npy, Raw };
+
+    ArrayFile() = default;
+    ~ArrayFile();
+    ArrayFile(const ArrayFile&) = delete;
+    ArrayFile& operator=(const ArrayFile&) = delete;
+
+    // Map a binary file. raw_columns is the row width of raw arrays (ignored for .npy).
+    // Returns false and sets error if the file cannot be mapped or has an unsupported layout.
+    bool open(const std::string& path, Format format, size_t raw_columns, std::string& error);
+    size_t rows() const { return rows_; }
+    size_t columns() const { return columns_; }
+    // Pointer to the first value of row i (rows are contiguous)
+    const double* row(size_t i) const { return data_ + i * columns_; }
+    // The whole array as a (contiguous, C order) view
+    ArrayView view() const { return ArrayView{data_, rows_, columns_, columns_, 1}; }
+
+    // Parse a format name: auto, text, npy or raw. Returns false for unknown names.
+    static bool parseFormat(const std::string& name, bool& automatic, Format& format);
+    // Resolve a format name for a file; auto picks npy for .npy, raw for .f64/.raw, text otherwise
+    static Format resolve(const std::string& name, const std::string& path);
+
+private:
+    // Parse the .npy header of the mapped file and locate the data
+    bool parseNpy(const char* bytes, size_t size, std::string& error);
+
+    void* map_ = nullptr;
+    size_t map_size_ = 0;
+    const double* data_ = nullptr;
+    size_t rows_ = 0;
+    size_t columns_ = 0;
+};
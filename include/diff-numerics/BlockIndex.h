@@ -0,0 +1,77 @@
+// BlockIndex.h
+// -------------------------------------------------------------
+// This header defines the BlockIndex class, a persistent fingerprint index
+// used to skip re-comparing unchanged regions of files that are diffed
+// repeatedly against the same reference.
+//
+// Both files are split into blocks of K non-comment lines and each block is
+// fingerprinted with two 64-bit content hashes. The index holds one entry per
+// block position of a pair of files: the fingerprints of the last block pair
+// found equal there. On a later run, a block pair whose fingerprints match its
+// entry is skipped; an entry is replaced when its blocks change, so the index
+// never grows beyond the blocks of the files it has seen.
+//
+// A changed block is skipped only if both of its hashes collide with the
+// verified ones (about 2^-128 for unrelated content). The hashes are not
+// cryptographic: an index is a cache for one's own files, not a defence
+// against crafted inputs.
+//
+// The index is bound to the comparison options through a signature, so
+// changing tolerance, threshold, columns, etc. invalidates it.
+// -------------------------------------------------------------
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class BlockIndex {
+public:
+    // Content fingerprint of a block: two hashes of different construction
+    struct Fingerprint {
+        uint64_t fnv = 0;   // FNV-1a
+        uint64_t poly = 0;  // Multiplicative hash, finished with a bit mixer
+        bool operator==(const Fingerprint& other) const { return fnv == other.fnv && poly == other.poly; }
+    };
+
+    // Constructor: index stored at path, for blocks of block_size lines,
+    // valid only for comparisons whose options hash to signature
+    BlockIndex(std::string path, size_t block_size, uint64_t signature);
+    // Load the index from disk. Returns false (and starts empty) if the file is
+    // missing or was written for a different block size or option signature.
+    bool load();
+    // Write the index back to disk. Returns false if the file cannot be written.
+    bool save() const;
+    // True if block number block of the file pair files was previously verified equal
+    // with the same content
+    bool isVerifiedEqual(uint64_t files, size_t block, const Fingerprint& print1,
+                         const Fingerprint& print2) const;
+    // Record a block pair that compared equal, replacing the entry of its position
+    void markEqual(uint64_t files, size_t block, const Fingerprint& print1, const Fingerprint& print2) {
+        entries_[{files, block}] = {print1, print2};
+    }
+    // Drop the entry of a block pair that now differs
+    void forget(uint64_t files, size_t block) { entries_.erase({files, block}); }
+    // Drop the entries of a file pair from block number blocks on (past the end of the files)
+    void truncate(uint64_t files, size_t blocks);
+    size_t blockSize() const { return block_size_; }
+    size_t size() const { return entries_.size(); }
+
+    // FNV-1a 64-bit hash of a byte range, chained through seed
+    static uint64_t hash(std::string_view data, uint64_t seed = kHashSeed);
+    // Fingerprint of a block of lines (line contents plus line boundaries)
+    static Fingerprint hashLines(const std::vector<std::string>& lines);
+
+    static constexpr uint64_t kHashSeed = 14695981039346656037ULL;
+
+private:
+    std::string path_;
+    size_t block_size_;
+    uint64_t signature_;
+    // (file pair signature, block number) -> fingerprints of the verified block pair
+    std::map<std::pair<uint64_t, size_t>, std::pair<Fingerprint, Fingerprint>> entries_;
+};
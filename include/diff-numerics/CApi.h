@@ -0,0 +1,94 @@
+/* CApi.h
+ * -------------------------------------------------------------
+ * This header declares the C interface of the diff-numerics shared library
+ * (libdiffnumerics), for comparing data held in memory by Fortran, Python
+ * or C programs without writing it to files.
+ *
+ * A comparator is created once from command-line style options (the same
+ * options as diff-numerics, without file names) and can then compare any
+ * number of pairs of text buffers or arrays of doubles. Inputs are never
+ * copied. Arrays are described by their shape and strides in elements, so
+ * C (row-major) and Fortran (column-major) arrays and NumPy views can be
+ * passed as they are.
+ *
+ * Functions return the number of differing lines, or -1 on error (see
+ * dn_last_error). A comparator must not be used by two threads at once;
+ * distinct comparators are independent.
+ * -------------------------------------------------------------
+ */
+
+#ifndef DIFF_NUMERICS_CAPI_H
+#define DIFF_NUMERICS_CAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define DN_API __attribute__((visibility("default")))
+#else
+#define DN_API
+#endif
+
+/* Incremented whenever a struct below or a function signature changes */
+#define DN_API_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct dn_comparator dn_comparator;
+
+/* A rows x columns array of doubles; strides are in elements (not bytes) */
+typedef struct dn_array {
+    const double* data;
+    size_t rows;
+    size_t columns;
+    size_t row_stride;    /* Between consecutive rows (C order: columns, Fortran order: 1) */
+    size_t column_stride; /* Between consecutive columns (C order: 1, Fortran order: rows) */
+} dn_array;
+
+/* Outcome of a comparison */
+typedef struct dn_result {
+    uint64_t lines;           /* Data lines (array rows) compared */
+    uint64_t differing_lines; /* Lines with at least one value over tolerance */
+    double max_percent_error; /* Largest percentage error over tolerance (0 if none) */
+} dn_result;
+
+/* Cells over tolerance in one column */
+typedef struct dn_column_stats {
+    uint64_t differing_cells;
+    uint64_t first_differing_line; /* 1-based; 0 if no cell differs */
+    double max_percent_error;
+} dn_column_stats;
+
+/* Version of this interface (DN_API_VERSION of the library) */
+DN_API int dn_api_version(void);
+
+/* Create a comparator from argc options as given on the command line, e.g.
+ * {"-t", "1e-6", "-C", "2,3"}. Output options (-y, -d, --format, ...) and
+ * --block-index are accepted and ignored: comparisons print and write nothing.
+ * Returns NULL only if out of memory; if the options are invalid, the
+ * comparisons fail and dn_last_error says why. */
+DN_API dn_comparator* dn_create(int argc, const char* const* argv);
+
+/* Destroy a comparator (NULL is allowed) */
+DN_API void dn_destroy(dn_comparator* comparator);
+
+/* Compare two text buffers, as diff-numerics compares two text files. stats (may
+ * be NULL) receives the statistics of input columns 1 to n_stats; result may be NULL. */
+DN_API int dn_compare_text(dn_comparator* comparator, const char* data1, size_t size1, const char* data2,
+                           size_t size2, dn_result* result, dn_column_stats* stats, size_t n_stats);
+
+/* Compare two arrays of the same shape, as diff-numerics compares two binary arrays */
+DN_API int dn_compare_arrays(dn_comparator* comparator, const dn_array* array1, const dn_array* array2,
+                             dn_result* result, dn_column_stats* stats, size_t n_stats);
+
+/* Error message of the last failed call on comparator ("" if none); valid until the
+ * next call on the same comparator */
+DN_API const char* dn_last_error(const dn_comparator* comparator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DIFF_NUMERICS_CAPI_H */
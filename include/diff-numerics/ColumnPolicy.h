@@ -0,0 +1,94 @@
+// ColumnPolicy.h
+// -------------------------------------------------------------
+// This header defines ColumnPolicy, the rule deciding whether two values of
+// one column differ, and the parsing of per-column policy specifications.
+//
+// Modes:
+//   rel    percentage difference above tolerance (the global -t/-T rule)
+//   abs    absolute difference above tolerance
+//   ulp    more than tolerance units in the last place apart (integer
+//          distance between the ordered bit patterns, no division)
+//   exact  any difference
+// Except in exact mode, two values both below the threshold are equal.
+//
+// A specification is "<columns>:<mode>[:<tolerance>[:<threshold>]]", where
+// <columns> is a comma-separated list of 1-based columns, e.g. "3,4:abs:1e-9".
+// A policy file holds one specification per line, with the fields separated
+// by colons or blanks; '#' starts a comment.
+// -------------------------------------------------------------
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+struct ColumnPolicy {
+    enum class Mode { Relative, Absolute, Ulp, Exact };
+
+    Mode mode = Mode::Relative;
+    double tolerance = 1e-2;  // Percent (rel), absolute difference (abs) or ULPs (ulp)
+    double threshold = 1e-6;  // Values both below this are equal (not in exact mode)
+
+    // Percentage difference of two values; 1e99 if only one of them is below threshold
+    static double relativeDifference(double value1, double value2, double threshold) {
+        if (std::abs(value1) < threshold && std::abs(value2) < threshold) return 0.0;
+        if ((std::abs(value1) < threshold && std::abs(value2) >= threshold) ||
+            (std::abs(value2) < threshold && std::abs(value1) >= threshold)) {
+            return 1.E99;
+        }
+        return std::abs(value1 - value2) / std::max(std::abs(value1), std::abs(value2)) * 100.0;
+    }
+
+    // Number of representable doubles between two values
+    static uint64_t ulpDistance(double value1, double value2) {
+        auto ordered = [](double value) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            const uint64_t sign = 1ULL << 63;
+            return (bits & sign) ? sign - (bits & ~sign) : sign + bits;
+        };
+        uint64_t a = ordered(value1), b = ordered(value2);
+        return a > b ? a - b : b - a;
+    }
+
+    // True if the values differ under this policy; error is then their percentage difference
+    bool differs(double value1, double value2, double& error) const {
+        bool differ = false;
+        if (mode == Mode::Relative) {
+            error = relativeDifference(value1, value2, threshold);
+            return error > tolerance;
+        }
+        if (std::isnan(value1) || std::isnan(value2)) {
+            differ = !(std::isnan(value1) && std::isnan(value2));
+        } else if (mode == Mode::Exact) {
+            differ = value1 < value2 || value1 > value2;
+        } else if (std::abs(value1) < threshold && std::abs(value2) < threshold) {
+            differ = false;
+        } else if (mode == Mode::Absolute) {
+            differ = std::abs(value1 - value2) > tolerance;
+        } else {
+            differ = static_cast<double>(ulpDistance(value1, value2)) > tolerance;
+        }
+        if (differ) error = relativeDifference(value1, value2, mode == Mode::Exact ? 0.0 : threshold);
+        return differ;
+    }
+};
+
+// A policy for a set of columns, as written by the user (tolerance and threshold may be
+// left to the global -t/-T values)
+struct ColumnPolicyRule {
+    std::set<size_t> columns;  // 1-based
+    ColumnPolicy::Mode mode = ColumnPolicy::Mode::Relative;
+    std::optional<double> tolerance;
+    std::optional<double> threshold;
+
+    // Parse "<columns>:<mode>[:<tolerance>[:<threshold>]]"; false with a message on error
+    static bool parse(const std::string& spec, ColumnPolicyRule& rule, std::string& error);
+    // Read one rule per line from a policy file; false with a message on error
+    static bool load(const std::string& path, std::vector<ColumnPolicyRule>& rules, std::string& error);
+};
@@ -0,0 +1,62 @@
+// ComparisonServer.h
+// -------------------------------------------------------------
+// This header defines the ComparisonServer class, which implements the
+// persistent comparison daemon (diff-numerics --serve) and its thin client.
+//
+// The server listens on a Unix domain socket. Each connection carries one
+// job: the client's working directory and command-line arguments. The job
+// runs on a worker pool with the same options as the command line, reading
+// its inputs through a shared ReferenceCache, and the client receives the
+// exit code and the captured standard output and error. Only processes of
+// the server's own user may connect: the socket has mode 0600 and the
+// peer of every connection is checked (SO_PEERCRED).
+//
+// Wire format (native byte order, local socket only):
+//   request: u32 count, then count strings (cwd, arg1, ..., argN)
+//   reply:   i32 exit code, stdout string, stderr string
+//   string:  u32 length, then the bytes
+// -------------------------------------------------------------
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "diff-numerics/ReferenceCache.h"
+
+class ComparisonServer {
+public:
+    // Constructor: serve on socket_path with a cache of cache_bytes and jobs worker threads.
+    // A client that stalls for io_timeout_ms while sending a request or receiving the
+    // reply is disconnected, so that it cannot hold a worker.
+    ComparisonServer(std::string socket_path, size_t cache_bytes, size_t jobs, int io_timeout_ms = 10000);
+    // Accept and run jobs until stop() is called or SIGINT/SIGTERM is received.
+    // Returns 0 on a clean shutdown, -1 if the socket cannot be set up.
+    int serve();
+    // Ask a running serve() to return (thread-safe)
+    void stop();
+    const ReferenceCache& cache() const { return cache_; }
+
+    // Client side: send one job and collect the reply. Returns false if the server
+    // cannot be reached or the connection breaks.
+    static bool request(const std::string& socket_path, const std::string& cwd,
+                        const std::vector<std::string>& args, int& exit_code,
+                        std::string& out, std::string& err);
+    // Thin client for main(): forward argv, print the server's output, return true and
+    // set exit_code if the job ran on the server
+    static bool runClient(const std::string& socket_path, int argc, char* argv[], int& exit_code);
+
+private:
+    // Run one job read from a connected socket and send the reply
+    void handleConnection(int fd);
+    // Parse the arguments and run the comparison, capturing its output
+    int runJob(const std::string& cwd, const std::vector<std::string>& args, std::string& out,
+               std::string& err);
+
+    std::string socket_path_;
+    size_t jobs_;
+    int io_timeout_ms_;
+    ReferenceCache cache_;
+    std::atomic<int> listen_fd_{-1};
+    std::atomic<bool> stopping_{false};
+};
@@ -0,0 +1,57 @@
+// FieldReader.h
+// -------------------------------------------------------------
+// This header defines the FieldReader class, a streaming tokenizer used by
+// the wide-row mode of NumericDiff.
+//
+// Instead of reading a whole line with std::getline, FieldReader reads the
+// fields of the current line a segment at a time through a fixed-size
+// buffer. Memory use is bounded by the buffer and the segment size, no matter
+// how long the lines are.
+// -------------------------------------------------------------
+
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class FieldReader {
+public:
+    // Constructor: read from in through a buffer of buffer_size bytes
+    explicit FieldReader(std::istream& in, size_t buffer_size = 1 << 16);
+    // Move to the next line that is not a comment (comment may be empty).
+    // Must be called at the start of each line; returns false at end of input.
+    bool nextLine(const std::string& comment);
+    // Scan up to max_columns fields of the current line, starting at 0-based column
+    // first_column. Only fields selected in mask are stored (all fields if mask is
+    // empty). Returns the number of fields scanned; fewer than max_columns means the
+    // line ended (or the last selected column was passed). Views stay valid until the
+    // next call.
+    size_t readFields(size_t max_columns, const std::vector<bool>& mask, size_t first_column,
+                      std::vector<std::string_view>& tokens);
+    // Discard the rest of the current line
+    void skipLine();
+    // Total bytes read from the stream so far
+    size_t bytesRead() const { return bytes_read_; }
+
+    // Field separators, as used by formatted stream extraction
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    }
+
+private:
+    // Make at least n bytes available after pos_ if the input allows; returns bytes available
+    size_t fill(size_t n);
+    // Next byte, or -1 at end of input
+    int peek() { return (pos_ < end_ || fill(1) > 0) ? static_cast<unsigned char>(buffer_[pos_]) : -1; }
+
+    std::istream& in_;
+    std::vector<char> buffer_;
+    size_t pos_ = 0;
+    size_t end_ = 0;
+    bool end_of_line_ = false;
+    size_t bytes_read_ = 0;
+    std::string storage_;           // Field bytes of the current segment, NUL-separated
+    std::vector<size_t> offsets_;   // Start of each stored field in storage_
+};
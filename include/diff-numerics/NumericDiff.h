@@ -8,10 +8,21 @@
 // -------------------------------------------------------------
 
 #pragma once
+#include <cstdint>
+#include <fstream>
+#include <iostream>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "diff-numerics/ArrayFile.h"
+#include "diff-numerics/ColumnPolicy.h"
 #include "diff-numerics/NumericDiffOption.h"
+#include "diff-numerics/ParsedText.h"
+#include "diff-numerics/Profiler.h"
+#include "diff-numerics/Progress.h"
+#include "diff-numerics/RecordWriter.h"
+#include "diff-numerics/StyledLine.h"
 
 class NumericDiff {
 public:
@@ -20,6 +31,43 @@ public:
     // Run the comparison and print results according to options and returns the number of differing lines or 
     // -1 if an error occurred (e.g., file not found)
     int run();
+    // Send normal output and error messages to the given streams instead of stdout/stderr
+    void setOutput(std::ostream& out, std::ostream& err) {
+        out_ = &out;
+        err_ = &err;
+    }
+    // Compare in-memory contents instead of reading the files (the file names are still
+    // used to pick the input format and in messages). The data is not copied and must
+    // outlive run().
+    void setInputData(std::string_view data1, std::string_view data2);
+    // Compare two already parsed inputs (see ParsedText): as setInputData(), but in line
+    // mode the cached fields and values are compared without tokenizing or parsing again.
+    // The inputs are not copied and must outlive run().
+    void setParsedInputs(const ParsedText& data1, const ParsedText& data2);
+    // Compare two in-memory arrays of doubles instead of reading the files, as binary
+    // inputs are compared. The arrays are not copied and must outlive run().
+    void setInputArrays(const ArrayView& array1, const ArrayView& array2);
+    // Statistics of the cells over tolerance in one input column
+    struct ColumnStats {
+        size_t differing_cells = 0;
+        size_t first_line = 0;  // Data line of the first differing cell (1-based)
+        double max_error = 0.0;
+    };
+    // Collect per-column statistics into stats during run(), indexed by input column - 1
+    // (null: none). Columns after the last differing one may be left out.
+    void setColumnStats(std::vector<ColumnStats>* stats) { column_stats_ = stats; }
+    // Resolve relative file paths against dir instead of the process working directory
+    void setWorkingDirectory(const std::string& dir) { working_dir_ = dir; }
+    // Collect phase timings and counters into profiler during run() (null: no profiling).
+    // The profiler must outlive run(); starting and stopping it is up to the caller.
+    void setProfiler(Profiler* profiler) { profiler_ = profiler; }
+    // Number of line blocks skipped thanks to the block fingerprint index in the last run
+    size_t skippedBlocks() const { return skipped_blocks_; }
+    // Data lines compared and largest percentage error over tolerance in the last run
+    size_t linesCompared() const { return lines_compared_; }
+    double maxPercentageError() const { return max_percentage_error_; }
+    // Cells found equal by comparing their text, without parsing, in the last run
+    size_t fastPathCells() const { return fast_path_cells_; }
 private:
     // File paths and options
     std::string file1_;
@@ -34,8 +82,116 @@ private:
     bool only_equal_;
     bool quiet_;
     bool color_diff_digits_ = false;
+    std::string color_when_;   // always, never or auto (only when out_ is a terminal)
+    bool color_ = false;       // Resolved from color_when_ at the start of run()
     std::set<size_t> columns_to_compare_;
+    std::vector<bool> column_mask_;  // Projection bitmap built from columns_to_compare_
+    std::vector<size_t> selected_columns_;  // columns_to_compare_ in order, for record column numbers
+    std::vector<std::string> column_policy_specs_;
+    std::string policy_file_;
+    // Per-column policies resolved for this run, indexed by compared column (after -C
+    // projection); columns past the end use default_policy_ (the global -t/-T rule).
+    // Empty if no policy was given, in which case the plain kernels are used.
+    std::vector<ColumnPolicy> column_policies_;
+    ColumnPolicy default_policy_;
+    std::string block_index_path_;
+    size_t block_size_;
+    size_t wide_row_columns_;  // Columns per segment in wide-row mode (0: line mode)
+    bool blocks_;              // Blank-line-separated block mode
+    size_t jobs_;              // Worker threads for block mode (0: hardware threads)
+    std::string input_format1_;  // auto, text, npy or raw
+    std::string input_format2_;
+    size_t raw_columns_;         // Row width of raw binary arrays
+    std::ostream* out_ = &std::cout;  // Destination of all normal output
+    std::ostream* err_ = &std::cerr;  // Destination of error messages
+    std::string working_dir_;         // Base of relative paths (empty: process working directory)
+    bool has_input_data_ = false;     // Inputs given with setInputData()
+    std::string_view input_data1_, input_data2_;
+    const ParsedText* parsed1_ = nullptr;  // Set by setParsedInputs()
+    const ParsedText* parsed2_ = nullptr;
+    bool has_input_arrays_ = false;   // Inputs given with setInputArrays()
+    ArrayView input_array1_, input_array2_;
+    std::vector<ColumnStats>* column_stats_ = nullptr;  // Set by setColumnStats()
+    Profiler* profiler_ = nullptr;    // Set by setProfiler(); shared with block workers
+    std::string output_format_;       // text, jsonl or csv
+    uint64_t max_output_bytes_;
+    uint64_t max_records_;
+    RecordWriter* record_writer_ = nullptr;  // Destination of jsonl / csv records during run()
+    mutable size_t lines_compared_ = 0;  // Data lines compared (or skipped) so far
+    mutable size_t column_offset_ = 0;   // Compared columns before the current wide-row segment
+    bool progress_enabled_;
+    Progress* progress_ = nullptr;       // Set during run() with --progress
+    mutable uint64_t progress_bytes_ = 0;           // Input bytes consumed so far
+    mutable uint64_t progress_next_ = UINT64_MAX;   // progress_bytes_ at which to look at the clock
 private:
+    // Helper: path to open for a file name given in the options
+    std::string resolvePath(const std::string& path) const;
+    // Helper: check that both files exist and open them
+    bool openFiles(std::ifstream& fin1, std::ifstream& fin2) const;
+    // Helper: read the next non-comment line; returns false (and clears line) at end of file
+    bool readDataLine(std::istream& in, std::string& line) const;
+    // Compare two streams line by line
+    void compareStreams(std::istream& in1, std::istream& in2);
+    // Compare two parsed inputs line by line, without tokenizing or parsing
+    void compareParsed(const ParsedText& in1, const ParsedText& in2);
+    // Helper: fields of one line of a parsed input (empty past its end), projected with -C
+    void gatherFields(const ParsedText& in, size_t line, std::vector<std::string_view>& tokens,
+                      std::vector<double>& values, std::vector<bool>& numeric) const;
+    // Compare two streams segment by segment, without reading whole lines
+    void compareWideRows(std::istream& in1, std::istream& in2);
+    // One pair of blank-line-separated blocks and the outcome of their comparison
+    struct BlockJob {
+        std::vector<std::string> lines1, lines2;
+        std::string output;
+        size_t first_line = 0;  // Data lines before the block
+        std::vector<ColumnStats> column_stats;
+        size_t fast_path_cells = 0;
+        size_t diff_lines = 0;
+        double max_error = 0.0;
+    };
+    // Helper: read the next blank-line-separated block of non-comment lines; leading and
+    // trailing are the blank lines consumed before and after it (data lines, for numbering)
+    bool readBlock(std::istream& in, std::vector<std::string>& block, size_t& leading, size_t& trailing) const;
+    // Compare one pair of blocks (thread-safe: works on a private copy of this object)
+    void compareBlock(BlockJob& job) const;
+    // Compare two streams block by block on a worker pool, with per-block summaries
+    void compareBlocks(std::istream& in1, std::istream& in2);
+    // Compare inputs when at least one is a binary array; false on shape or format errors
+    bool compareArrayInputs(std::istream& in1, std::istream& in2, ArrayFile::Format format1,
+                            ArrayFile::Format format2);
+    // Compare two binary arrays of the same shape, without any parsing
+    void compareBinaryRows(const ArrayView& array1, const ArrayView& array2);
+    // Compare a text file with a binary array; false on shape mismatch
+    bool compareTextWithArray(std::istream& text, const std::string& text_path,
+                              const ArrayView& array, const std::string& array_path, bool text_first);
+    // Helper: format the selected values of a binary row as NUL-terminated tokens
+    void formatRow(const ArrayView& array, size_t row, std::string& storage,
+                   std::vector<std::string_view>& tokens) const;
+    // Helper: add a cell over tolerance (compared column k, after projection) to column_stats_
+    void recordColumnStats(size_t k, double error) const;
+    // Helper: add the statistics of a later part of the input (a block) to column_stats_
+    void mergeColumnStats(const std::vector<ColumnStats>& stats) const;
+    // Compare two streams block by block, skipping block pairs verified equal in the index
+    void compareIndexedBlocks(std::istream& in1, std::istream& in2);
+    // Count input bytes for --progress: a single add and compare unless a report is due
+    void advanceProgress(uint64_t bytes) const {
+        progress_bytes_ += bytes;
+        if (progress_bytes_ >= progress_next_) reportProgress();
+    }
+    // Helper: pass the counters to progress_ and set the next checkpoint
+    void reportProgress() const;
+    // Helper: total size of the inputs, for the progress ETA (0 if unknown)
+    uint64_t inputBytes() const;
+    // Helper: read the policy file and specifications into column_policies_; false on error
+    bool resolvePolicies();
+    // Policy of compared column k (0-based, after projection)
+    const ColumnPolicy& policyFor(size_t k) const {
+        return k < column_policies_.size() ? column_policies_[k] : default_policy_;
+    }
+    // Hash of every option that affects whether two lines compare equal
+    uint64_t optionsSignature() const;
+    // Hash of the compared files, which keys their entries in a block index
+    uint64_t filesSignature() const;
     // Helper: count columns in a file
     uint filesColumns(const std::string& file) const;
     // Helper: check if a line is a comment
@@ -54,33 +210,97 @@ private:
         size_t pos = line.find(comment_char_);
         return (pos == std::string::npos) ? line : line.substr(0, pos);
     }
-    // Helper: check if a string is numeric
-    bool isNumeric(const std::string& str) const;
-    // Compare two lines and print results
-    void compareLine(const std::string& line1, const std::string& line2) const;
+    // Helper: parse a token as a number; false if the token is not entirely numeric
+    bool parseNumber(std::string_view token, double& value) const;
+    // Outcome of comparing one line (possibly accumulated over several segments)
+    struct LineResult {
+        bool any_error = false;
+        double max_error = 0.0;
+    };
+    // Values of two rows parsed in advance (see ParsedText), given to a token kernel
+    // instead of parsing the tokens: numeric1[i] is set if tokens1[i] is a number
+    struct RowValues {
+        std::vector<double> values1, values2;
+        std::vector<bool> numeric1, numeric2;
+    };
+    // Compare two lines and print results, through the kernel selected for this run
+    void compareLine(const std::string& line1, const std::string& line2) const {
+        (this->*kernels_.line)(line1, line2);
+    }
+    // Update diff_lines_, max_percentage_error_ and lines_compared_ with the outcome of one line
+    void recordLine(const LineResult& result) const;
+    // Output-mode policy: the option combination a comparison kernel is specialised for.
+    // Branches on these flags are resolved at compile time (if constexpr), so the
+    // per-line and per-token loops carry no checks for options that are off. Per-column
+    // policies and profiling are rare and independent of the output mode, so they stay
+    // run-time branches rather than doubling the number of kernels each.
+    template <bool Columns, bool ColorDigits, bool SummaryOnly, bool SideBySide,
+              bool SuppressCommon, bool Records>
+    struct LineMode {
+        static constexpr bool kColumns = Columns;                // -C: project selected columns only
+        static constexpr bool kColorDigits = ColorDigits;        // -d: color only differing digits
+        static constexpr bool kSummaryOnly = SummaryOnly;        // -s: no per-line output
+        static constexpr bool kSideBySide = SideBySide;          // -y: side-by-side output
+        static constexpr bool kSuppressCommon = SuppressCommon;  // -ys: hide equal lines
+        static constexpr bool kRecords = Records;                // --format jsonl|csv: cell records
+    };
+    using LineKernel = void (NumericDiff::*)(const std::string&, const std::string&) const;
+    using TokensKernel = void (NumericDiff::*)(const std::vector<std::string_view>&,
+                                               const std::vector<std::string_view>&,
+                                               LineResult&, const RowValues*) const;
+    struct Kernels {
+        LineKernel line = nullptr;      // Whole lines: tokenize, compare, record statistics
+        TokensKernel tokens = nullptr;  // Already tokenized (or parsed) rows or wide-row segments
+    };
+    // Comparison kernels specialised for one output mode
+    template <class Mode>
+    void compareLineKernel(const std::string& line1, const std::string& line2) const;
+    template <class Mode>
+    void compareTokensKernel(const std::vector<std::string_view>& tokens1,
+                             const std::vector<std::string_view>& tokens2,
+                             LineResult& result, const RowValues* parsed) const;
+    // Select the kernels for the current options (called once per run)
+    Kernels selectKernels() const;
+    template <bool... Fixed>
+    static Kernels pickKernels();
+    template <bool... Fixed, typename... Rest>
+    static Kernels pickKernels(bool next, Rest... rest);
+    template <bool Columns, bool ColorDigits, bool SummaryOnly, bool SideBySide,
+              bool SuppressCommon, bool Records>
+    static Kernels kernelsFor();
+    Kernels kernels_;
     // Compute percentage difference between two values
     double percentageDifference(double value1, double value2) const;
     // Compare two values (not used directly)
     void compareValues(double value1, double value2) const;
-    // Print diff output in various formats
-    void printDiff(const std::string& line1, const std::string& line2, const std::string& errors) const;
-    // Print side-by-side tokens, aligning columns. Never truncate or cut numeric values: if a value is longer than the max column width, the column expands to fit the value. The max column width only limits padding/alignment, not the content of the numbers. ANSI color codes are ignored for width calculations.
-    void printSideBySideTokens(const std::vector<std::string>& tokens1, const std::vector<std::string>& tokens2, const std::vector<size_t>& col_widths) const;
-    // Print a string in red (for errors)
-    inline void printRed(std::string& str) const {
-        // Placeholder for red text output, e.g., using ANSI escape codes
-        str = "\033[31m" + str + "\033[0m"; // Red color
-    }
-    // Remove ANSI color codes from a string
-    std::string stripAnsi(const std::string& input) const;
-    // Extract the first n visible (non-ANSI) characters from a string, preserving formatting codes
-    std::string extractVisiblePrefix(const std::string& input, size_t n) const;
-    // Ensure the string ends with the ANSI reset code if the last color set is not reset
-    void ensureAnsiReset(std::string& str) const;
-    // Helper: colorize only the differing digits between two numeric strings
-    void colorizeDiffDigits(std::string& s1, std::string& s2) const;
+    // Print diff output: both lines and the error line, if either line is highlighted
+    void printDiff(const StyledLine& line1, const StyledLine& line2, const std::string& errors) const;
+    // Print side-by-side lines, each cut to line_length_ visible characters. Columns are
+    // padded while the lines are built, so no width is recomputed here.
+    void printSideBySide(const StyledLine& line1, const StyledLine& line2) const;
+    // Helper: append two numeric tokens, highlighting only from the first differing digit
+    void appendDiffDigits(std::string_view s1, std::string_view s2, StyledLine& line1,
+                          StyledLine& line2) const;
+
+    // Working storage of the line kernels, reused from line to line (cleared, never
+    // shrunk) so that steady-state comparison makes no heap allocations. Block workers
+    // copy it with the rest of the object, so each thread has its own.
+    struct LineScratch {
+        std::vector<std::string_view> tokens1, tokens2;
+        RowValues row_values;               // Values of parsed inputs (compareParsed)
+        std::vector<double> column_errors;  // Error of each column over the tolerance
+        std::vector<bool> is_diff;          // Columns over the tolerance
+        std::vector<double> values1, values2;  // Parsed values (profiling kernels only)
+        std::vector<bool> numeric;             // Both values parsed (profiling kernels only)
+        std::vector<size_t> col_widths;
+        StyledLine line1, line2;
+        std::string errors;
+    };
+    mutable LineScratch scratch_;
 
     // For summary/statistics
     mutable size_t diff_lines_ = 0;
     mutable double max_percentage_error_ = 0.0;
+    mutable size_t fast_path_cells_ = 0;  // Cells with identical text: equal without parsing
+    size_t skipped_blocks_ = 0;
 };
@@ -1,7 +1,9 @@
 // NumericDiffOption.h
 #pragma once
 #include <string>
+#include <cstdint>
 #include <set>
+#include <vector>
 #include <iostream>
 
 class NumericDiffOption {
@@ -16,16 +18,40 @@ public:
     bool quiet = false;
     int line_length = 60;
     bool color_diff_digits = false;
+    std::string color = "auto";  // ANSI colors: always, never or auto (when stdout is a terminal)
     std::set<size_t> columns_to_compare;
+    std::vector<std::string> column_policies;  // Per-column policies "<columns>:<mode>[:<tol>[:<threshold>]]"
+    std::string policy_file;     // File of per-column policies (applied before column_policies)
+    std::string block_index;     // Path of the persistent block fingerprint index (empty: disabled)
+    size_t block_size = 64;      // Number of lines per fingerprinted block
+    size_t wide_row_columns = 0; // Wide-row mode: columns per segment (0: disabled)
+    bool blocks = false;         // Compare blank-line-separated blocks independently
+    size_t jobs = 0;             // Worker threads for block mode (0: one per hardware thread)
+    std::string input_format1 = "auto";  // Input format of file1: auto, text, npy or raw
+    std::string input_format2 = "auto";  // Input format of file2
+    size_t raw_columns = 1;      // Number of columns (row width) of raw binary arrays
+    std::string serve_socket;    // Run as comparison server on this Unix socket
+    std::string connect_socket;  // Send the comparison to the server on this Unix socket
+    size_t cache_mb = 256;       // Memory budget of the server's file cache, in MiB
+    std::string output_format = "text";  // Output: text, or jsonl / csv records per differing cell
+    uint64_t max_output_bytes = 0;  // Cap on the size of jsonl / csv cell records (0: none)
+    uint64_t max_records = 0;       // Cap on the number of jsonl / csv cell records (0: none)
+    std::string profile;         // Phase timing report on stderr: text or json (empty: disabled)
+    bool perf_counters = false;  // Add hardware counters (perf_event_open) to the profile
+    bool progress = false;       // Periodic progress report on stderr
     std::string file1, file2;
 
     NumericDiffOption() = default;
-    bool parse_args(int argc, char* argv[]);
-    bool validate_options() const;
-    static bool parse_columns(const std::string& col_arg, std::set<size_t>& columns_to_compare, const std::string& usage);
+    // Errors (followed by the usage text) are written to err
+    bool parse_args(int argc, char* argv[], std::ostream& err = std::cerr);
+    bool validate_options(std::ostream& err = std::cerr) const;
+    // Parse a non-negative integer option value strictly; false if it is not one
+    static bool parse_count(const std::string& text, size_t& value);
+    static bool parse_columns(const std::string& col_arg, std::set<size_t>& columns_to_compare,
+                              const std::string& usage, std::ostream& err = std::cerr);
     static const std::string usage;
     static void print_usage();
 
-    bool parse(int argc, char* argv[]);
-    bool validate() const;
+    bool parse(int argc, char* argv[], std::ostream& err = std::cerr);
+    bool validate(std::ostream& err = std::cerr) const;
 };
@@ -0,0 +1,45 @@
+// ParsedText.h
+// -------------------------------------------------------------
+// This header defines ParsedText, the data lines of a text input split into
+// fields and parsed into numbers once, so that a comparison can reuse them
+// without tokenizing or calling strtod again.
+//
+// It is the form in which the comparison server caches reference files (see
+// ReferenceCache); NumericDiff::setParsedInputs() compares two of them.
+// -------------------------------------------------------------
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ParsedText {
+    // One whitespace-separated field: its text, and its value if the whole field is numeric
+    struct Field {
+        size_t offset = 0;  // In text
+        uint32_t length = 0;
+        bool numeric = false;
+        double value = 0.0;
+    };
+
+    std::string text;                // Data lines, each '\n'-terminated
+    std::vector<size_t> line_starts;  // Offset of each line in text, then text.size()
+    std::vector<size_t> first_field;  // Index of the first field of each line, then fields.size()
+    std::vector<Field> fields;
+
+    size_t lines() const { return first_field.size() - 1; }
+    // Line i without its '\n'
+    std::string_view line(size_t i) const {
+        return std::string_view(text).substr(line_starts[i], line_starts[i + 1] - line_starts[i] - 1);
+    }
+    std::string_view field(const Field& f) const { return std::string_view(text).substr(f.offset, f.length); }
+    // Memory held, for cache budgets
+    size_t bytes() const;
+
+    // Split and parse '\n'-terminated data lines (comments already removed), with the same
+    // rules as the line comparison. Returns nullptr if a field is too long to be indexed.
+    static std::shared_ptr<const ParsedText> parse(std::string text);
+};
@@ -0,0 +1,112 @@
+// Profiler.h
+// -------------------------------------------------------------
+// This header defines the Profiler class, which collects the phase timings
+// and throughput counters reported by diff-numerics --profile.
+//
+// A comparison is split into five phases: reading input, tokenizing lines,
+// parsing numbers, comparing values, and building/printing output. Each
+// phase accumulates wall-clock time through Profiler::Scope; reading the
+// thread CPU clock is a system call, so it is only sampled (the first scopes
+// of each phase and one in kCpuSampleInterval after that) and per-phase CPU
+// time is extrapolated from the sampled scopes.
+// Counters are atomic, so the worker threads of block mode can share one
+// profiler. Process-wide figures (CPU time, peak RSS, heap allocations and,
+// optionally, hardware counters from perf_event_open) are sampled around
+// the run.
+// -------------------------------------------------------------
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Profiler {
+public:
+    enum Phase { kRead, kTokenize, kParse, kCompare, kPrint, kPhaseCount };
+
+    // RAII timer adding the elapsed wall and thread CPU time to a phase. With a null
+    // profiler it does nothing, and compiles to nothing when the null is a constant.
+    class Scope {
+    public:
+        Scope(Profiler* profiler, Phase phase) : profiler_(profiler), phase_(phase) {
+            if (profiler_ != nullptr) begin();
+        }
+        ~Scope() {
+            if (profiler_ != nullptr) end();
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        void begin();
+        void end();
+        Profiler* profiler_;
+        Phase phase_;
+        std::chrono::steady_clock::time_point wall_start_;
+        int64_t cpu_start_ns_ = -1;  // -1: CPU time not sampled in this scope
+    };
+
+    // Constructor: with hardware_counters, try to open perf_event counters
+    explicit Profiler(bool hardware_counters = false);
+    ~Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Mark the beginning and end of the profiled run
+    void start();
+    void stop();
+
+    void addBytes(uint64_t n) { bytes_.fetch_add(n, std::memory_order_relaxed); }
+    void addLines(uint64_t n) { lines_.fetch_add(n, std::memory_order_relaxed); }
+    void addTokens(uint64_t n) { tokens_.fetch_add(n, std::memory_order_relaxed); }
+    void addParses(uint64_t n) { parses_.fetch_add(n, std::memory_order_relaxed); }
+    void addFastPathCells(uint64_t n) { fast_path_cells_.fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t bytes() const { return bytes_.load(); }
+    uint64_t lines() const { return lines_.load(); }
+    uint64_t tokens() const { return tokens_.load(); }
+    uint64_t parses() const { return parses_.load(); }
+    uint64_t fastPathCells() const { return fast_path_cells_.load(); }
+
+    // Write the report, human-readable or as a single JSON object
+    void report(std::ostream& os, bool json) const;
+
+    // Install the function returning the number of heap allocations so far (the
+    // executable counts them in its replacement operator new). Without it, heap
+    // allocations are not reported.
+    static void setAllocationCounter(uint64_t (*counter)());
+    static const char* phaseName(Phase phase);
+
+    static constexpr uint32_t kCpuSampleInterval = 16;
+
+private:
+    struct HardwareCounter {
+        std::string name;
+        int fd = -1;
+        uint64_t value = 0;
+    };
+    void openHardwareCounters();
+    // Estimated CPU time of a phase, in seconds
+    double phaseCpuSeconds(int phase) const;
+
+    std::atomic<int64_t> wall_ns_[kPhaseCount] = {};
+    std::atomic<int64_t> sampled_wall_ns_[kPhaseCount] = {};
+    std::atomic<int64_t> sampled_cpu_ns_[kPhaseCount] = {};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> lines_{0};
+    std::atomic<uint64_t> tokens_{0};
+    std::atomic<uint64_t> parses_{0};
+    std::atomic<uint64_t> fast_path_cells_{0};  // Cells equal as text, never parsed
+
+    std::chrono::steady_clock::time_point run_start_, run_stop_;
+    int64_t cpu_clock_overhead_ns_ = 0;  // CPU time a sampled scope spends reading clocks
+    int64_t process_cpu_start_ns_ = 0, process_cpu_ns_ = 0;
+    uint64_t allocations_start_ = 0, allocations_ = 0;
+    long peak_rss_kb_ = 0;
+    bool hardware_counters_;
+    std::vector<HardwareCounter> counters_;
+};
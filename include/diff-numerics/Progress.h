@@ -0,0 +1,42 @@
+// Progress.h
+// -------------------------------------------------------------
+// This header defines the Progress class, which prints the periodic status
+// line of diff-numerics --progress: bytes processed, lines and megabytes per
+// second, differing lines so far and estimated time left.
+//
+// The comparison loops only add up the bytes they consume; the clock is
+// looked at once every kCheckBytes bytes of input, and a line is printed at
+// most once per interval. On a terminal the line is rewritten in place.
+// -------------------------------------------------------------
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+class Progress {
+public:
+    // Input bytes between two looks at the clock
+    static constexpr uint64_t kCheckBytes = 1 << 20;
+
+    // Constructor: total_bytes is the size of both inputs (0: unknown, no ETA); with
+    // rewrite, each report overwrites the previous one (for terminals)
+    Progress(std::ostream& os, uint64_t total_bytes, bool rewrite, double interval_seconds = 1.0);
+
+    // Print a report if the interval has passed since the last one
+    void update(uint64_t bytes, uint64_t lines, uint64_t diff_lines);
+    // Print the final report
+    void finish(uint64_t bytes, uint64_t lines, uint64_t diff_lines);
+
+private:
+    // Helper: print one report line
+    void print(uint64_t bytes, uint64_t lines, uint64_t diff_lines, bool done);
+
+    std::ostream& os_;
+    uint64_t total_bytes_;
+    bool rewrite_;
+    std::chrono::steady_clock::duration interval_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point last_report_;
+    size_t last_width_ = 0;  // Length of the line to overwrite (rewrite mode)
+};
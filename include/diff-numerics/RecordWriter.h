@@ -0,0 +1,69 @@
+// RecordWriter.h
+// -------------------------------------------------------------
+// This header defines the RecordWriter class, which writes the
+// machine-readable output of --format jsonl|csv.
+//
+// Each differing cell becomes one compact record (line, column, both values,
+// percentage error), followed at the end by one summary record. Records are
+// formatted into a reusable buffer and written in large chunks. Optional
+// caps on the number of cell records and on their total size keep the
+// output of huge diffs bounded; once a cap is hit, all further cell records
+// are dropped (the output stays a prefix) and the summary says so.
+// -------------------------------------------------------------
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+class RecordWriter {
+public:
+    enum class Format { Jsonl, Csv };
+
+    // Figures of the final summary record
+    struct Summary {
+        std::string file1, file2;
+        size_t lines = 0;            // Data lines compared
+        size_t differing_lines = 0;
+        double max_percent_error = 0.0;
+    };
+
+    // Constructor: write to out; max_bytes and max_records cap the cell records (0: no cap)
+    RecordWriter(std::ostream& out, Format format, uint64_t max_bytes = 0, uint64_t max_records = 0);
+    ~RecordWriter() { flush(); }
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    // Write the CSV column header (nothing for JSON Lines)
+    void header();
+    // Write one differing cell; line and column are 1-based
+    void cell(size_t line, size_t column, double value1, double value2, double percent_error);
+    // Copy cell records written by another writer (one per line), applying this writer's caps
+    void append(std::string_view records);
+    // Write the summary record; it is never capped
+    void summary(const Summary& summary);
+    // Write buffered records to the stream
+    void flush();
+
+    uint64_t records() const { return records_; }
+    uint64_t dropped() const { return dropped_; }
+
+    // Parse a format name (jsonl or csv); false if unknown
+    static bool parseFormat(const std::string& name, Format& format);
+
+private:
+    // Add the record in record_ to the buffer if the caps allow it
+    void commit();
+
+    std::ostream& out_;
+    Format format_;
+    uint64_t max_bytes_;
+    uint64_t max_records_;
+    std::string buffer_;  // Records not yet written to out_
+    std::string record_;  // Record being formatted
+    uint64_t bytes_ = 0;
+    uint64_t records_ = 0;
+    uint64_t dropped_ = 0;
+};
@@ -0,0 +1,56 @@
+// ReferenceCache.h
+// -------------------------------------------------------------
+// This header defines the ReferenceCache class, an in-memory LRU cache of
+// parsed input files used by the comparison server (diff-numerics --serve).
+//
+// An entry holds the data lines of a file (comment lines removed), already
+// split into fields and parsed (ParsedText), keyed by path and comment string. Entries are revalidated against the file's
+// modification time and size on every lookup, and the least recently used
+// entries are evicted to keep the total size within a memory budget.
+// -------------------------------------------------------------
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include "diff-numerics/ParsedText.h"
+
+class ReferenceCache {
+public:
+    // Constructor: keep at most budget_bytes of file data in memory
+    explicit ReferenceCache(size_t budget_bytes);
+    // Parsed data lines of a file (comments removed), loaded or served from the cache.
+    // Returns nullptr if the file cannot be read. Thread-safe.
+    std::shared_ptr<const ParsedText> get(const std::string& path, const std::string& comment);
+
+    size_t bytes() const;
+    size_t entries() const;
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    using Key = std::pair<std::string, std::string>;  // (path, comment string)
+    struct Entry {
+        std::shared_ptr<const ParsedText> data;
+        int64_t mtime_ns = 0;
+        uint64_t size = 0;
+        std::list<Key>::iterator lru;
+    };
+    // Read a file, keep only its data lines and parse them
+    static std::shared_ptr<const ParsedText> load(const std::string& path, const std::string& comment);
+    // Drop least recently used entries until the budget is respected (lock held)
+    void evict();
+
+    size_t budget_bytes_;
+    size_t bytes_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    std::list<Key> lru_;  // Most recently used first
+    std::map<Key, Entry> entries_;
+    mutable std::mutex mutex_;
+};
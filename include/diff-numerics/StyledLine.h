@@ -0,0 +1,52 @@
+// StyledLine.h
+// -------------------------------------------------------------
+// This header defines the StyledLine class, an output line whose text and
+// highlighting are kept apart.
+//
+// Text is appended plain; highlighted (red) parts are recorded as byte
+// ranges of the text. The visible width is therefore simply the text size,
+// and ANSI escape codes are only produced by write(), when the line is
+// printed, and only if colour output is enabled.
+// -------------------------------------------------------------
+
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class StyledLine {
+public:
+    // Drop text and highlights, keeping the allocated storage
+    void clear() {
+        text_.clear();
+        runs_.clear();
+    }
+    // Append text, highlighted in red if red is true
+    void append(std::string_view text, bool red = false) {
+        if (red) runs_.emplace_back(text_.size(), text_.size() + text.size());
+        text_.append(text);
+    }
+    // Append n spaces
+    void pad(size_t n) { text_.append(n, ' '); }
+    // Visible width (the escape codes written by write() take no space)
+    size_t width() const { return text_.size(); }
+    // True if any part of the line is highlighted
+    bool highlighted() const { return !runs_.empty(); }
+    const std::string& text() const { return text_; }
+
+    // Write at most max_width visible characters; with color, highlighted parts are
+    // wrapped in ANSI red / reset codes. A highlight cut by max_width is closed at the cut.
+    void write(std::ostream& os, bool color,
+               size_t max_width = std::numeric_limits<size_t>::max()) const;
+
+    static constexpr const char* kRed = "\033[31m";
+    static constexpr const char* kReset = "\033[0m";
+
+private:
+    std::string text_;
+    std::vector<std::pair<size_t, size_t>> runs_;  // Highlighted [begin, end) ranges of text_
+};
@@ -0,0 +1,51 @@
+// ThreadPool.h
+// -------------------------------------------------------------
+// This header defines the ThreadPool class, a minimal fixed-size pool of
+// worker threads consuming a FIFO queue of tasks.
+//
+// It is used to compare independent blocks of data in parallel. With a
+// single thread no worker is started and tasks run inline in submit().
+// An exception thrown by a task is kept and rethrown by wait().
+// -------------------------------------------------------------
+
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // Constructor: start n worker threads (n <= 1: run tasks inline)
+    explicit ThreadPool(size_t n);
+    // Destructor: finish queued tasks and join the workers
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task for execution
+    void submit(std::function<void()> task);
+    // Block until every submitted task has finished; rethrow the first exception a
+    // task threw since the last wait()
+    void wait();
+    size_t size() const { return workers_.size(); }
+
+    // Number of threads to use for a requested job count (0: one per hardware thread)
+    static size_t resolveJobs(size_t jobs);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable task_ready_;
+    std::condition_variable all_done_;
+    size_t running_ = 0;
+    std::exception_ptr error_;  // First exception thrown by a task
+    bool stopping_ = false;
+};
@@ -0,0 +1,183 @@
+// ArrayFile.cpp
+// -------------------------------------------------------------
+// This file implements the ArrayFile class: memory mapping of binary inputs
+// and parsing of the NumPy .npy header.
+// -------------------------------------------------------------
+
+#include "diff-numerics/ArrayFile.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Destructor: unmap the file
+ArrayFile::~ArrayFile() {
+    if (map_ != nullptr) munmap(map_, map_size_);
+}
+
+// Map the whole file read-only; the data is never copied
+bool ArrayFile::open(const std::string& path, Format format, size_t raw_columns, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Cannot open file '" + path + "'";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        error = "Cannot stat file '" + path + "'";
+        return false;
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    if (map_size_ > 0) {
+        map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map_ == MAP_FAILED) {
+            map_ = nullptr;
+            ::close(fd);
+            error = "Cannot map file '" + path + "'";
+            return false;
+        }
+        madvise(map_, map_size_, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+
+    const char* bytes = static_cast<const char*>(map_);
+    if (format == Format::Npy) {
+        if (!parseNpy(bytes, map_size_, error)) {
+            error = "'" + path + "': " + error;
+            return false;
+        }
+        return true;
+    }
+    // Raw little-endian doubles
+    columns_ = raw_columns;
+    if (columns_ == 0 || columns_ > SIZE_MAX / sizeof(double) || map_size_ % (columns_ * sizeof(double)) != 0) {
+        error = "'" + path + "': size " + std::to_string(map_size_) +
+                " bytes is not a whole number of rows of " + std::to_string(raw_columns) + " doubles";
+        return false;
+    }
+    rows_ = map_size_ / (columns_ * sizeof(double));
+    data_ = reinterpret_cast<const double*>(bytes);
+    return true;
+}
+
+// .npy layout: "\x93NUMPY", major, minor, header length (2 bytes in v1, 4 bytes in v2/v3),
+// then a Python dict literal such as {'descr': '<f8', 'fortran_order': False, 'shape': (3, 4), }
+bool ArrayFile::parseNpy(const char* bytes, size_t size, std::string& error) {
+    if (size < 10 || std::memcmp(bytes, "\x93NUMPY", 6) != 0) {
+        error = "not a .npy file";
+        return false;
+    }
+    unsigned major = static_cast<unsigned char>(bytes[6]);
+    size_t header_len = 0, header_start = 0;
+    if (major == 1) {
+        header_len = static_cast<unsigned char>(bytes[8]) | (static_cast<size_t>(static_cast<unsigned char>(bytes[9])) << 8);
+        header_start = 10;
+    } else if ((major == 2 || major == 3) && size >= 12) {
+        for (size_t i = 0; i < 4; ++i) header_len |= static_cast<size_t>(static_cast<unsigned char>(bytes[8 + i])) << (8 * i);
+        header_start = 12;
+    } else {
+        error = "unsupported .npy version " + std::to_string(major);
+        return false;
+    }
+    if (header_start + header_len > size) {
+        error = "truncated .npy header";
+        return false;
+    }
+    std::string header(bytes + header_start, header_len);
+    size_t data_offset = header_start + header_len;
+
+    // Value of a dict key, as the text following "'key':"
+    auto value_of = [&header](const std::string& key) -> std::string {
+        size_t pos = header.find("'" + key + "'");
+        if (pos == std::string::npos) return "";
+        pos = header.find(':', pos);
+        if (pos == std::string::npos) return "";
+        pos = header.find_first_not_of(" ", pos + 1);
+        return pos == std::string::npos ? "" : header.substr(pos);
+    };
+    std::string descr = value_of("descr");
+    if (descr.compare(0, 5, "'<f8'") != 0) {
+        error = "only little-endian float64 ('<f8') arrays are supported";
+        return false;
+    }
+    bool fortran_order = value_of("fortran_order").compare(0, 4, "True") == 0;
+    std::string shape = value_of("shape");
+    if (shape.empty() || shape[0] != '(' || shape.find(')') == std::string::npos) {
+        error = "malformed shape in .npy header";
+        return false;
+    }
+    shape = shape.substr(1, shape.find(')') - 1);
+    size_t dims[2] = {1, 1};
+    size_t ndim = 0;
+    for (size_t pos = 0; pos < shape.size();) {
+        size_t next = shape.find(',', pos);
+        std::string item = shape.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+        size_t first = item.find_first_not_of(' ');
+        if (first != std::string::npos) {  // Empty after a trailing comma, as in (3,)
+            item = item.substr(first, item.find_last_not_of(' ') - first + 1);
+            if (ndim == 2) {
+                error = "arrays with more than 2 dimensions are not supported";
+                return false;
+            }
+            errno = 0;
+            char* end = nullptr;
+            unsigned long long dim = std::strtoull(item.c_str(), &end, 10);
+            if (item.find_first_not_of("0123456789") != std::string::npos || errno == ERANGE ||
+                end != item.c_str() + item.size() || dim > SIZE_MAX) {
+                error = "malformed shape in .npy header";
+                return false;
+            }
+            dims[ndim++] = static_cast<size_t>(dim);
+        }
+        if (next == std::string::npos) break;
+        pos = next + 1;
+    }
+    if (fortran_order && ndim == 2 && dims[0] > 1 && dims[1] > 1) {
+        error = "Fortran-ordered 2-D arrays are not supported";
+        return false;
+    }
+    rows_ = dims[0];
+    columns_ = (ndim == 2) ? dims[1] : 1;
+    // rows_ * columns_ doubles must fit after the header; divide rather than multiply,
+    // so that a crafted shape cannot wrap around
+    size_t available = (size - data_offset) / sizeof(double);
+    if (data_offset % alignof(double) != 0 || (columns_ > 0 && rows_ > available / columns_)) {
+        error = "data does not match the shape in the .npy header";
+        return false;
+    }
+    data_ = reinterpret_cast<const double*>(bytes + data_offset);
+    return true;
+}
+
+// Parse a format name
+bool ArrayFile::parseFormat(const std::string& name, bool& automatic, Format& format) {
+    automatic = (name == "auto");
+    if (automatic || name == "text") {
+        format = Format::Text;
+    } else if (name == "npy") {
+        format = Format::Npy;
+    } else if (name == "raw") {
+        format = Format::Raw;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Resolve the format of a file, detecting it from the extension in auto mode
+ArrayFile::Format ArrayFile::resolve(const std::string& name, const std::string& path) {
+    bool automatic = false;
+    Format format = Format::Text;
+    if (!parseFormat(name, automatic, format) || !automatic) return format;
+    auto ends_with = [&path](const std::string& ext) {
+        return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+    };
+    if (ends_with(".npy")) return Format::Npy;
+    if (ends_with(".f64") || ends_with(".raw")) return Format::Raw;
+    return Format::Text;
+}
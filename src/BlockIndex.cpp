@@ -0,0 +1,124 @@
+// BlockIndex.cpp
+// -------------------------------------------------------------
+// This file implements the BlockIndex class: block fingerprinting and the
+// on-disk format of the persistent index.
+//
+// The index is a small text file:
+//   diff-numerics-block-index 2
+//   block-size <K>
+//   signature <hex>
+//   <files hex> <block> <fnv1 hex> <poly1 hex> <fnv2 hex> <poly2 hex>
+//                                    (one line per verified-equal block position)
+// -------------------------------------------------------------
+
+#include "diff-numerics/BlockIndex.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+const char* const kIndexMagic = "diff-numerics-block-index";
+const int kIndexVersion = 2;
+const uint64_t kFnvPrime = 1099511628211ULL;
+const uint64_t kPolyMultiplier = 0x9E3779B97F4A7C15ULL;  // Odd: every step is invertible
+
+// splitmix64 finalizer: spreads every input bit over the whole word
+uint64_t mix(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+// Second hash of a byte range: adds bytes and multiplies, where FNV-1a xors and
+// multiplies by a sparse prime, so the two do not collide on the same inputs
+uint64_t polyHash(std::string_view data, uint64_t seed) {
+    uint64_t h = seed;
+    for (char c : data) h = (h + static_cast<unsigned char>(c) + 1) * kPolyMultiplier;
+    return h;
+}
+}  // namespace
+
+// Constructor: remember where the index lives and what it is valid for
+BlockIndex::BlockIndex(std::string path, size_t block_size, uint64_t signature)
+    : path_(std::move(path)), block_size_(block_size), signature_(signature) {}
+
+// Load the index; an unreadable or stale index (including one of an older version)
+// is treated as empty
+bool BlockIndex::load() {
+    entries_.clear();
+    std::ifstream fin(path_);
+    if (!fin.is_open()) return false;
+
+    std::string magic, key;
+    int version = 0;
+    size_t block_size = 0;
+    uint64_t signature = 0;
+    if (!(fin >> magic >> version) || magic != kIndexMagic || version != kIndexVersion) return false;
+    if (!(fin >> key >> block_size) || key != "block-size" || block_size != block_size_) return false;
+    if (!(fin >> key >> std::hex >> signature) || key != "signature" || signature != signature_) {
+        return false;
+    }
+    uint64_t files = 0;
+    size_t block = 0;
+    Fingerprint print1, print2;
+    while (fin >> files >> std::dec >> block >> std::hex >> print1.fnv >> print1.poly >> print2.fnv >>
+           print2.poly) {
+        entries_[{files, block}] = {print1, print2};
+    }
+    return true;
+}
+
+// Save the index, overwriting any previous content
+bool BlockIndex::save() const {
+    std::ofstream fout(path_, std::ios::trunc);
+    if (!fout.is_open()) return false;
+    fout << kIndexMagic << ' ' << kIndexVersion << '\n';
+    fout << "block-size " << block_size_ << '\n';
+    fout << "signature " << std::hex << std::setw(16) << std::setfill('0') << signature_ << '\n';
+    for (const auto& [key, prints] : entries_) {
+        fout << std::setw(16) << key.first << ' ' << std::dec << key.second << std::hex << ' '
+             << std::setw(16) << prints.first.fnv << ' ' << std::setw(16) << prints.first.poly << ' '
+             << std::setw(16) << prints.second.fnv << ' ' << std::setw(16) << prints.second.poly << '\n';
+    }
+    return fout.good();
+}
+
+// A block pair is verified if its position has an entry with the same fingerprints
+bool BlockIndex::isVerifiedEqual(uint64_t files, size_t block, const Fingerprint& print1,
+                                 const Fingerprint& print2) const {
+    auto it = entries_.find({files, block});
+    return it != entries_.end() && it->second.first == print1 && it->second.second == print2;
+}
+
+// Drop the entries of a file pair past its last block
+void BlockIndex::truncate(uint64_t files, size_t blocks) {
+    auto first = entries_.lower_bound({files, blocks});
+    auto last = first;
+    while (last != entries_.end() && last->first.first == files) ++last;
+    entries_.erase(first, last);
+}
+
+// FNV-1a: cheap, good enough to fingerprint text blocks
+uint64_t BlockIndex::hash(std::string_view data, uint64_t seed) {
+    uint64_t h = seed;
+    for (char c : data) {
+        h ^= static_cast<unsigned char>(c);
+        h *= kFnvPrime;
+    }
+    return h;
+}
+
+// Hash every line followed by a newline, so that line boundaries matter
+BlockIndex::Fingerprint BlockIndex::hashLines(const std::vector<std::string>& lines) {
+    Fingerprint print{kHashSeed, 0};
+    for (const auto& line : lines) {
+        print.fnv = hash(line, print.fnv);
+        print.fnv = hash("\n", print.fnv);
+        print.poly = polyHash(line, print.poly);
+        print.poly = polyHash("\n", print.poly);
+    }
+    print.poly = mix(print.poly);
+    return print;
+}
@@ -0,0 +1,176 @@
+// CApi.cpp
+// -------------------------------------------------------------
+// This file implements the C interface of the diff-numerics shared library:
+// comparators wrap a parsed NumericDiffOption, and each comparison runs a
+// NumericDiff on the caller's buffers in summary mode, with its output
+// discarded and its error messages kept for dn_last_error().
+// -------------------------------------------------------------
+
+#include "diff-numerics/CApi.h"
+#include "diff-numerics/NumericDiff.h"
+#include "diff-numerics/NumericDiffOption.h"
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+// Stream buffer that drops everything written to it
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Helper: first line of an error report (option errors are followed by the usage text)
+std::string firstLine(const std::string& text) {
+    return text.substr(0, text.find('\n'));
+}
+}  // namespace
+
+struct dn_comparator {
+    NumericDiffOption options;
+    bool valid = false;
+    std::string error;
+    std::vector<NumericDiff::ColumnStats> column_stats;
+    NullBuffer null_buffer;
+    std::ostream null_out{&null_buffer};
+};
+
+namespace {
+// Run one comparison with the comparator's options, naming the inputs name1 and name2;
+// set_inputs hands the caller's buffers to the NumericDiff. No exception leaves this function.
+template <class SetInputs>
+int compare(dn_comparator* comparator, const char* name1, const char* name2, SetInputs set_inputs,
+            dn_result* result, dn_column_stats* stats, size_t n_stats) {
+    if (comparator == nullptr) return -1;
+    if (!comparator->valid) return -1;  // The error of dn_create() is kept
+    comparator->error.clear();
+    try {
+        NumericDiffOption options = comparator->options;
+        options.file1 = name1;
+        options.file2 = name2;
+        // Buffers are parsed as text; array inputs do not look at the input formats
+        options.input_format1 = options.input_format2 = "text";
+        std::ostringstream err;
+        NumericDiff diff(options);
+        diff.setOutput(comparator->null_out, err);
+        if (!set_inputs(diff, comparator->error)) return -1;
+        comparator->column_stats.clear();
+        if (stats != nullptr) diff.setColumnStats(&comparator->column_stats);
+        int differing_lines = diff.run();
+        if (differing_lines < 0) {
+            comparator->error = firstLine(err.str());
+            return -1;
+        }
+        if (result != nullptr) {
+            result->lines = diff.linesCompared();
+            result->differing_lines = static_cast<uint64_t>(differing_lines);
+            result->max_percent_error = diff.maxPercentageError();
+        }
+        for (size_t c = 0; stats != nullptr && c < n_stats; ++c) {
+            NumericDiff::ColumnStats column;
+            if (c < comparator->column_stats.size()) column = comparator->column_stats[c];
+            stats[c].differing_cells = column.differing_cells;
+            stats[c].first_differing_line = column.first_line;
+            stats[c].max_percent_error = column.max_error;
+        }
+        return differing_lines;
+    } catch (const std::exception& e) {
+        comparator->error = std::string("Error: ") + e.what();
+        return -1;
+    }
+}
+}  // namespace
+
+extern "C" {
+
+int dn_api_version(void) { return DN_API_VERSION; }
+
+dn_comparator* dn_create(int argc, const char* const* argv) {
+    dn_comparator* comparator = nullptr;
+    try {
+        comparator = new dn_comparator;
+        // Parsed like a command line, with placeholder file names
+        std::vector<std::string> args = {"diff-numerics"};
+        for (int i = 0; i < argc; ++i) args.emplace_back(argv[i]);
+        for (size_t i = 1; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            // Options that exit the process or do not compare anything
+            if (arg == "-h" || arg == "--help" || arg == "-v" || arg == "--version" || arg == "--serve" ||
+                arg == "--connect") {
+                comparator->error = "Error: Option " + arg + " is not available in the library.";
+                return comparator;
+            }
+        }
+        args.emplace_back("input1");
+        args.emplace_back("input2");
+        std::vector<char*> c_args;
+        for (auto& arg : args) c_args.push_back(arg.data());
+        c_args.push_back(nullptr);
+
+        std::ostringstream err;
+        NumericDiffOption& options = comparator->options;
+        if (!options.parse(static_cast<int>(args.size()), c_args.data(), err) || !options.validate(err)) {
+            comparator->error = firstLine(err.str());
+            return comparator;
+        }
+        // Comparisons only collect statistics: summary mode, nothing printed or saved.
+        // The block index is a file cache keyed by file name: ignored for buffers.
+        options.only_equal = true;
+        options.quiet = false;
+        options.side_by_side = false;
+        options.suppress_common_lines = false;
+        options.color_diff_digits = false;
+        options.color = "never";
+        options.output_format = "text";
+        options.profile.clear();
+        options.progress = false;
+        options.connect_socket.clear();
+        options.block_index.clear();
+        comparator->valid = true;
+    } catch (const std::exception& e) {
+        if (comparator == nullptr) return nullptr;
+        comparator->error = std::string("Error: ") + e.what();
+    }
+    return comparator;
+}
+
+void dn_destroy(dn_comparator* comparator) { delete comparator; }
+
+int dn_compare_text(dn_comparator* comparator, const char* data1, size_t size1, const char* data2,
+                    size_t size2, dn_result* result, dn_column_stats* stats, size_t n_stats) {
+    auto set_inputs = [&](NumericDiff& diff, std::string& error) {
+        if ((data1 == nullptr && size1 > 0) || (data2 == nullptr && size2 > 0)) {
+            error = "Error: Null text buffer.";
+            return false;
+        }
+        diff.setInputData(std::string_view(data1 ? data1 : "", size1), std::string_view(data2 ? data2 : "", size2));
+        return true;
+    };
+    return compare(comparator, "text1", "text2", set_inputs, result, stats, n_stats);
+}
+
+int dn_compare_arrays(dn_comparator* comparator, const dn_array* array1, const dn_array* array2,
+                      dn_result* result, dn_column_stats* stats, size_t n_stats) {
+    auto set_inputs = [&](NumericDiff& diff, std::string& error) {
+        for (const dn_array* array : {array1, array2}) {
+            if (array == nullptr || (array->data == nullptr && array->rows > 0 && array->columns > 0)) {
+                error = "Error: Null array.";
+                return false;
+            }
+        }
+        diff.setInputArrays(ArrayView{array1->data, array1->rows, array1->columns, array1->row_stride,
+                                      array1->column_stride},
+                            ArrayView{array2->data, array2->rows, array2->columns, array2->row_stride,
+                                      array2->column_stride});
+        return true;
+    };
+    return compare(comparator, "array1", "array2", set_inputs, result, stats, n_stats);
+}
+
+const char* dn_last_error(const dn_comparator* comparator) {
+    return comparator != nullptr ? comparator->error.c_str() : "";
+}
+
+}  // extern "C"
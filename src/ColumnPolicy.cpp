@@ -0,0 +1,110 @@
+// ColumnPolicy.cpp
+// -------------------------------------------------------------
+// This file implements the parsing of per-column policy specifications and
+// policy files.
+// -------------------------------------------------------------
+
+#include "diff-numerics/ColumnPolicy.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+// Parse a non-negative number that must take the whole field
+bool parseValue(const std::string& field, double& value) {
+    char* end = nullptr;
+    value = std::strtod(field.c_str(), &end);
+    return !field.empty() && end == field.c_str() + field.size() && value >= 0.0;
+}
+}  // namespace
+
+bool ColumnPolicyRule::parse(const std::string& spec, ColumnPolicyRule& rule, std::string& error) {
+    std::vector<std::string> fields;
+    std::stringstream ss(spec);
+    std::string field;
+    while (std::getline(ss, field, ':')) fields.push_back(field);
+    if (fields.size() < 2 || fields.size() > 4) {
+        error = "Invalid column policy '" + spec + "' (expected <columns>:<mode>[:<tolerance>[:<threshold>]])";
+        return false;
+    }
+
+    rule = ColumnPolicyRule();
+    std::stringstream columns(fields[0]);
+    std::string column;
+    while (std::getline(columns, column, ',')) {
+        char* end = nullptr;
+        unsigned long number = std::strtoul(column.c_str(), &end, 10);
+        if (column.empty() || end != column.c_str() + column.size() || number < 1) {
+            error = "Invalid column '" + column + "' in column policy '" + spec + "' (columns are 1-based)";
+            return false;
+        }
+        rule.columns.insert(number);
+    }
+    if (rule.columns.empty()) {
+        error = "No columns in column policy '" + spec + "'";
+        return false;
+    }
+
+    const std::string& mode = fields[1];
+    if (mode == "rel") {
+        rule.mode = ColumnPolicy::Mode::Relative;
+    } else if (mode == "abs") {
+        rule.mode = ColumnPolicy::Mode::Absolute;
+    } else if (mode == "ulp") {
+        rule.mode = ColumnPolicy::Mode::Ulp;
+    } else if (mode == "exact") {
+        rule.mode = ColumnPolicy::Mode::Exact;
+    } else {
+        error = "Unknown mode '" + mode + "' in column policy '" + spec + "' (expected rel, abs, ulp or exact)";
+        return false;
+    }
+
+    double value = 0.0;
+    if (fields.size() > 2) {
+        if (!parseValue(fields[2], value)) {
+            error = "Invalid tolerance '" + fields[2] + "' in column policy '" + spec + "'";
+            return false;
+        }
+        rule.tolerance = value;
+    }
+    if (fields.size() > 3) {
+        if (!parseValue(fields[3], value)) {
+            error = "Invalid threshold '" + fields[3] + "' in column policy '" + spec + "'";
+            return false;
+        }
+        rule.threshold = value;
+    }
+    if ((rule.mode == ColumnPolicy::Mode::Absolute || rule.mode == ColumnPolicy::Mode::Ulp) &&
+        !rule.tolerance) {
+        error = "Column policy '" + spec + "' needs a tolerance";
+        return false;
+    }
+    return true;
+}
+
+// Policy file: one specification per line; blanks may separate the fields
+bool ColumnPolicyRule::load(const std::string& path, std::vector<ColumnPolicyRule>& rules,
+                            std::string& error) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        error = "Cannot open policy file '" + path + "'";
+        return false;
+    }
+    std::string line;
+    size_t number = 0;
+    while (std::getline(in, line)) {
+        ++number;
+        line = line.substr(0, line.find('#'));
+        std::stringstream words(line);
+        std::string word, spec;
+        while (words >> word) spec += (spec.empty() ? "" : ":") + word;
+        if (spec.empty()) continue;
+        ColumnPolicyRule rule;
+        if (!parse(spec, rule, error)) {
+            error = path + ":" + std::to_string(number) + ": " + error;
+            return false;
+        }
+        rules.push_back(rule);
+    }
+    return true;
+}
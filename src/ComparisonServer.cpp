@@ -0,0 +1,296 @@
+// ComparisonServer.cpp
+// -------------------------------------------------------------
+// This file implements the ComparisonServer class: Unix socket setup, the
+// accept loop, job execution on the worker pool, and the client side of the
+// protocol.
+// -------------------------------------------------------------
+
+#include "diff-numerics/ComparisonServer.h"
+#include "diff-numerics/ArrayFile.h"
+#include "diff-numerics/NumericDiff.h"
+#include "diff-numerics/NumericDiffOption.h"
+#include "diff-numerics/Profiler.h"
+#include "diff-numerics/ThreadPool.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+// Set by SIGINT/SIGTERM while serving
+volatile std::sig_atomic_t g_signal_received = 0;
+
+void onSignal(int) { g_signal_received = 1; }
+
+// Helper: write or read exactly size bytes; false on error or end of stream
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeString(int fd, const std::string& s) {
+    uint32_t size = static_cast<uint32_t>(s.size());
+    return writeAll(fd, &size, sizeof(size)) && writeAll(fd, s.data(), s.size());
+}
+
+// Read a length-prefixed string; false (without allocating) if it is longer than max_size
+bool readString(int fd, std::string& s, uint32_t max_size = UINT32_MAX) {
+    uint32_t size = 0;
+    if (!readAll(fd, &size, sizeof(size)) || size > max_size) return false;
+    s.resize(size);
+    return readAll(fd, &s[0], size);
+}
+
+// Helper: fill a Unix socket address; false if the path does not fit
+bool socketAddress(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Helper: true if the peer of a connected socket runs as the same user as the server
+bool samePeerUser(int fd) {
+    ucred cred;
+    socklen_t size = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 && cred.uid == ::geteuid();
+}
+
+// Helper: make reads and writes on a socket fail after timeout_ms instead of blocking
+void setTimeouts(int fd, int timeout_ms) {
+    timeval timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+// Helper: make a relative path absolute with respect to the client's directory
+std::string resolvePath(const std::string& path, const std::string& cwd) {
+    return (path.empty() || path[0] == '/') ? path : cwd + "/" + path;
+}
+}  // namespace
+
+// Constructor: nothing is opened until serve()
+ComparisonServer::ComparisonServer(std::string socket_path, size_t cache_bytes, size_t jobs, int io_timeout_ms)
+    : socket_path_(std::move(socket_path)), jobs_(jobs), io_timeout_ms_(io_timeout_ms), cache_(cache_bytes) {}
+
+// Bind the socket and dispatch every connection to the worker pool
+int ComparisonServer::serve() {
+    sockaddr_un addr;
+    if (!socketAddress(socket_path_, addr)) {
+        std::cerr << "Error: Socket path '" << socket_path_ << "' is too long.\n";
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot create socket: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    ::unlink(socket_path_.c_str());  // Stale socket from a previous server
+    // Jobs read and write files as the server's user: the socket is private to that user,
+    // made so before listen() lets anyone connect
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::chmod(socket_path_.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(fd, 64) != 0) {
+        std::cerr << "Error: Cannot listen on '" << socket_path_ << "': " << std::strerror(errno) << "\n";
+        ::close(fd);
+        return -1;
+    }
+    listen_fd_ = fd;
+
+    // No SA_RESTART: a signal interrupts accept() so that the loop can exit
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    struct sigaction old_int, old_term;
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    {
+        ThreadPool pool(std::max<size_t>(ThreadPool::resolveJobs(jobs_), 2));
+        while (!stopping_ && !g_signal_received) {
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                break;  // Listening socket shut down by stop()
+            }
+            // Peers of another user are turned away, even if the socket mode was changed
+            if (!samePeerUser(client)) {
+                ::close(client);
+                continue;
+            }
+            setTimeouts(client, io_timeout_ms_);
+            pool.submit([this, client] { handleConnection(client); });
+        }
+        // The pool destructor lets running and queued jobs finish
+    }
+
+    sigaction(SIGINT, &old_int, nullptr);
+    sigaction(SIGTERM, &old_term, nullptr);
+    ::close(fd);
+    ::unlink(socket_path_.c_str());
+    return 0;
+}
+
+// Wake up accept() by shutting the listening socket down
+void ComparisonServer::stop() {
+    stopping_ = true;
+    int fd = listen_fd_;
+    if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+}
+
+// Limits of a request: number of strings (working directory and arguments) and length
+// of each, so that a malformed request cannot make the server allocate without bound
+namespace {
+constexpr uint32_t kMaxRequestStrings = 4096;
+constexpr uint32_t kMaxRequestString = 1 << 16;
+}  // namespace
+
+// Read a request, run it and send the reply
+void ComparisonServer::handleConnection(int fd) {
+    uint32_t count = 0;
+    std::string cwd;
+    std::vector<std::string> args;
+    bool ok = readAll(fd, &count, sizeof(count)) && count >= 1 && count <= kMaxRequestStrings &&
+              readString(fd, cwd, kMaxRequestString);
+    for (uint32_t i = 1; ok && i < count; ++i) {
+        args.emplace_back();
+        ok = readString(fd, args.back(), kMaxRequestString);
+    }
+    if (ok) {
+        std::string out, err;
+        int32_t exit_code = -1;
+        // A failing job must not take the server down with it
+        try {
+            exit_code = runJob(cwd, args, out, err);
+        } catch (const std::exception& e) {
+            out.clear();
+            err = std::string("Error: Comparison failed: ") + e.what() + "\n";
+        }
+        if (writeAll(fd, &exit_code, sizeof(exit_code)) && writeString(fd, out)) writeString(fd, err);
+    }
+    ::close(fd);
+}
+
+// Run one comparison with the client's options. Text inputs are served from the cache.
+int ComparisonServer::runJob(const std::string& cwd, const std::vector<std::string>& args,
+                             std::string& out, std::string& err) {
+    // Options that print and exit, or start another server, make no sense in a job
+    for (const auto& arg : args) {
+        if (arg == "-v" || arg == "--version" || arg == "-h" || arg == "--help" || arg == "--serve") {
+            err = "Error: Option " + arg + " is not accepted by the comparison server.\n";
+            return -1;
+        }
+    }
+    std::vector<char*> argv;
+    std::string program = "diff-numerics";
+    argv.push_back(&program[0]);
+    std::vector<std::string> arg_copies(args);
+    for (auto& arg : arg_copies) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    // The client validates the same arguments before sending them, but a request may come
+    // from elsewhere: the diagnostic goes back to the client, not to the server's stderr
+    NumericDiffOption opts;
+    std::ostringstream option_err;
+    if (!opts.parse(static_cast<int>(args.size() + 1), argv.data(), option_err) || !opts.validate(option_err)) {
+        err = option_err.str();
+        return -1;
+    }
+    // The job's stderr only reaches the client with the reply, too late for progress reports
+    opts.progress = false;
+
+    // Paths are resolved in the client's directory but printed as the client gave them
+    std::ostringstream out_stream, err_stream;
+    NumericDiff diff(opts);
+    diff.setOutput(out_stream, err_stream);
+    diff.setWorkingDirectory(cwd);
+    std::shared_ptr<const ParsedText> data1, data2;
+    if (ArrayFile::resolve(opts.input_format1, opts.file1) == ArrayFile::Format::Text &&
+        ArrayFile::resolve(opts.input_format2, opts.file2) == ArrayFile::Format::Text) {
+        data1 = cache_.get(resolvePath(opts.file1, cwd), opts.comment_char);
+        data2 = cache_.get(resolvePath(opts.file2, cwd), opts.comment_char);
+        // If a file cannot be read, run() reads it itself and reports the error
+        if (data1 && data2) diff.setParsedInputs(*data1, *data2);
+    }
+    // Process-wide figures of a profile (CPU, memory) include concurrent jobs
+    Profiler profiler(opts.perf_counters);
+    if (!opts.profile.empty()) {
+        diff.setProfiler(&profiler);
+        profiler.start();
+    }
+    int exit_code = diff.run();
+    if (!opts.profile.empty()) {
+        profiler.stop();
+        profiler.report(err_stream, opts.profile == "json");
+    }
+    out = out_stream.str();
+    err = err_stream.str();
+    return exit_code;
+}
+
+// Send one request and wait for the reply
+bool ComparisonServer::request(const std::string& socket_path, const std::string& cwd,
+                               const std::vector<std::string>& args, int& exit_code,
+                               std::string& out, std::string& err) {
+    sockaddr_un addr;
+    if (!socketAddress(socket_path, addr)) return false;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    uint32_t count = static_cast<uint32_t>(args.size() + 1);
+    bool ok = writeAll(fd, &count, sizeof(count)) && writeString(fd, cwd);
+    for (size_t i = 0; ok && i < args.size(); ++i) ok = writeString(fd, args[i]);
+    int32_t code = 0;
+    ok = ok && readAll(fd, &code, sizeof(code)) && readString(fd, out) && readString(fd, err);
+    ::close(fd);
+    exit_code = code;
+    return ok;
+}
+
+// Forward the command line unchanged and replay the server's output locally
+bool ComparisonServer::runClient(const std::string& socket_path, int argc, char* argv[],
+                                 int& exit_code) {
+    // The server writes to a buffer: resolve automatic colors against the client's
+    // stdout. An explicit --color later on the command line still wins.
+    std::vector<std::string> args = {"--color", ::isatty(STDOUT_FILENO) ? "always" : "never"};
+    args.insert(args.end(), argv + 1, argv + argc);
+    char cwd[4096];
+    if (::getcwd(cwd, sizeof(cwd)) == nullptr) return false;
+    std::string out, err;
+    if (!request(socket_path, cwd, args, exit_code, out, err)) return false;
+    std::cout << out << std::flush;
+    std::cerr << err << std::flush;
+    return true;
+}
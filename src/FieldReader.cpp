@@ -0,0 +1,100 @@
+// FieldReader.cpp
+// -------------------------------------------------------------
+// This file implements the FieldReader class: buffered, segment-at-a-time
+// field scanning of arbitrarily long lines, with whole-line comment skipping
+// matching NumericDiff::isLineComment().
+// -------------------------------------------------------------
+
+#include "diff-numerics/FieldReader.h"
+#include <algorithm>
+#include <cstring>
+
+// Constructor: allocate the read buffer once
+FieldReader::FieldReader(std::istream& in, size_t buffer_size)
+    : in_(in), buffer_(std::max<size_t>(buffer_size, 16)) {}
+
+// Compact the unread bytes to the front of the buffer and refill it from the stream
+size_t FieldReader::fill(size_t n) {
+    if (end_ - pos_ >= n) return end_ - pos_;
+    std::memmove(buffer_.data(), buffer_.data() + pos_, end_ - pos_);
+    end_ -= pos_;
+    pos_ = 0;
+    while (end_ < n && in_) {
+        in_.read(buffer_.data() + end_, static_cast<std::streamsize>(buffer_.size() - end_));
+        size_t got = static_cast<size_t>(in_.gcount());
+        if (got == 0) break;
+        end_ += got;
+        bytes_read_ += got;
+    }
+    return end_ - pos_;
+}
+
+// Skip whole-line comments; a line is a comment if its first non-blank characters
+// are the comment string
+bool FieldReader::nextLine(const std::string& comment) {
+    while (true) {
+        end_of_line_ = false;
+        if (peek() < 0) return false;
+        if (comment.empty()) return true;
+        int c;
+        while ((c = peek()) == ' ' || c == '\t') ++pos_;
+        if (fill(comment.size()) >= comment.size() &&
+            std::memcmp(buffer_.data() + pos_, comment.data(), comment.size()) == 0) {
+            skipLine();
+            continue;
+        }
+        return true;
+    }
+}
+
+// Scan fields of the current line into storage_, keeping only the selected ones
+size_t FieldReader::readFields(size_t max_columns, const std::vector<bool>& mask,
+                               size_t first_column, std::vector<std::string_view>& tokens) {
+    tokens.clear();
+    storage_.clear();
+    offsets_.clear();
+    size_t scanned = 0;
+    while (scanned < max_columns && !end_of_line_) {
+        if (!mask.empty() && first_column + scanned >= mask.size()) break;
+        // Skip separators up to the next field or the end of the line
+        int c;
+        while ((c = peek()) >= 0 && c != '\n' && isSpace(static_cast<char>(c))) ++pos_;
+        if (c < 0 || c == '\n') {
+            if (c == '\n') ++pos_;
+            end_of_line_ = true;
+            break;
+        }
+        bool keep = mask.empty() || mask[first_column + scanned];
+        if (keep) offsets_.push_back(storage_.size());
+        while (true) {
+            if (pos_ == end_ && fill(1) == 0) break;
+            size_t start = pos_;
+            while (pos_ < end_ && !isSpace(buffer_[pos_])) ++pos_;
+            if (keep) storage_.append(buffer_.data() + start, pos_ - start);
+            if (pos_ < end_) break;
+        }
+        // NUL-terminate each field, so that it can be handed to strtod
+        if (keep) storage_.push_back('\0');
+        ++scanned;
+    }
+    // storage_ is complete: the views can be taken now
+    for (size_t i = 0; i < offsets_.size(); ++i) {
+        size_t stop = (i + 1 < offsets_.size()) ? offsets_[i + 1] : storage_.size();
+        tokens.emplace_back(storage_.data() + offsets_[i], stop - offsets_[i] - 1);
+    }
+    return scanned;
+}
+
+// Consume everything up to and including the next newline
+void FieldReader::skipLine() {
+    while (!end_of_line_) {
+        if (pos_ == end_ && fill(1) == 0) break;
+        const void* nl = std::memchr(buffer_.data() + pos_, '\n', end_ - pos_);
+        if (nl != nullptr) {
+            pos_ = static_cast<size_t>(static_cast<const char*>(nl) - buffer_.data()) + 1;
+            break;
+        }
+        pos_ = end_;
+    }
+    end_of_line_ = true;
+}
@@ -13,15 +13,23 @@
 
 #include "../include/diff-numerics/NumericDiff.h"
 #include "diff-numerics/NumericDiffOption.h"
+#include "diff-numerics/ArrayFile.h"
+#include "diff-numerics/BlockIndex.h"
+#include "diff-numerics/FieldReader.h"
+#include "diff-numerics/ThreadPool.h"
 #include <iostream>
+#include <memory>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <charconv>
 #include <cmath>
 #include <numeric>
 #include <iomanip> // For std::setw
 #include <set>
+#include <unistd.h>
 
 // Constructor: initialize from options struct
 NumericDiff::NumericDiff(const NumericDiffOption& opts)
@@ -36,105 +44,598 @@ NumericDiff::NumericDiff(const NumericDiffOption& opts)
       only_equal_(opts.only_equal),
       quiet_(opts.quiet),
       color_diff_digits_(opts.color_diff_digits),
-      columns_to_compare_(opts.columns_to_compare) {}
+      color_when_(opts.color),
+      columns_to_compare_(opts.columns_to_compare),
+      column_policy_specs_(opts.column_policies),
+      policy_file_(opts.policy_file),
+      block_index_path_(opts.block_index),
+      block_size_(opts.block_size),
+      wide_row_columns_(opts.wide_row_columns),
+      blocks_(opts.blocks),
+      jobs_(opts.jobs),
+      input_format1_(opts.input_format1),
+      input_format2_(opts.input_format2),
+      raw_columns_(opts.raw_columns),
+      output_format_(opts.output_format),
+      max_output_bytes_(opts.max_output_bytes),
+      max_records_(opts.max_records),
+      progress_enabled_(opts.progress) {
+    // Column projection bitmap: column_mask_[i] is set if column i + 1 is compared,
+    // and its size is the last selected column, where line scanning stops
+    if (!columns_to_compare_.empty()) {
+        column_mask_.assign(*columns_to_compare_.rbegin(), false);
+        for (size_t col : columns_to_compare_) column_mask_[col - 1] = true;
+    }
+    selected_columns_.assign(columns_to_compare_.begin(), columns_to_compare_.end());
+    // Records replace the human-readable output and its layout options
+    if (output_format_ != "text") {
+        side_by_side_ = false;
+        suppress_common_lines_ = false;
+        color_diff_digits_ = false;
+    }
+}
+
+namespace {
+// Read-only stream buffer over memory owned by someone else: in-memory inputs are
+// streamed without being copied
+class ViewStreamBuf : public std::streambuf {
+public:
+    explicit ViewStreamBuf(std::string_view data) {
+        char* begin = const_cast<char*>(data.data());
+        setg(begin, begin, begin + data.size());
+    }
+};
+}  // namespace
+
+// Compare in-memory contents instead of reading file1_ and file2_
+void NumericDiff::setInputData(std::string_view data1, std::string_view data2) {
+    input_data1_ = data1;
+    input_data2_ = data2;
+    has_input_data_ = true;
+    parsed1_ = nullptr;
+    parsed2_ = nullptr;
+}
+
+// Compare parsed inputs; their text is also the input data of the other modes
+void NumericDiff::setParsedInputs(const ParsedText& data1, const ParsedText& data2) {
+    setInputData(data1.text, data2.text);
+    parsed1_ = &data1;
+    parsed2_ = &data2;
+}
+
+// Compare in-memory arrays instead of reading file1_ and file2_
+void NumericDiff::setInputArrays(const ArrayView& array1, const ArrayView& array2) {
+    input_array1_ = array1;
+    input_array2_ = array2;
+    has_input_arrays_ = true;
+}
+
+// Resolve relative paths against working_dir_ (if set); paths are printed as given
+std::string NumericDiff::resolvePath(const std::string& path) const {
+    if (working_dir_.empty() || path.empty() || path[0] == '/') return path;
+    return working_dir_ + "/" + path;
+}
 
 // Main entry: run the comparison and print results
 int NumericDiff::run() {
     diff_lines_ = 0;
     max_percentage_error_ = 0.0;
-    std::ifstream fin1(file1_), fin2(file2_);
+    skipped_blocks_ = 0;
+    lines_compared_ = 0;
+    column_offset_ = 0;
+    fast_path_cells_ = 0;
+    progress_bytes_ = 0;
+    // Escape codes are only written to a terminal, unless asked otherwise
+    color_ = color_when_ == "always" ||
+             (color_when_ == "auto" && out_ == &std::cout && isatty(STDOUT_FILENO));
+    // In-memory inputs (see setInputData) are read through non-copying stream buffers
+    ViewStreamBuf data1_buf(input_data1_), data2_buf(input_data2_);
+    std::istream data1(&data1_buf), data2(&data2_buf);
+    std::ifstream file_in1, file_in2;
+    if (!has_input_data_ && !has_input_arrays_ && !openFiles(file_in1, file_in2)) {
+        return -1; // Error code for file access issues
+    }
+    std::istream& fin1 = has_input_data_ ? data1 : static_cast<std::istream&>(file_in1);
+    std::istream& fin2 = has_input_data_ ? data2 : static_cast<std::istream&>(file_in2);
+
+    ArrayFile::Format format1 = ArrayFile::resolve(input_format1_, file1_);
+    ArrayFile::Format format2 = ArrayFile::resolve(input_format2_, file2_);
+    bool binary = has_input_arrays_ || format1 != ArrayFile::Format::Text || format2 != ArrayFile::Format::Text;
+    if (binary && (blocks_ || wide_row_columns_ > 0 || !block_index_path_.empty())) {
+        *err_ << "Error: Binary inputs cannot be combined with --blocks, --wide-rows or --block-index.\n";
+        return -1;
+    }
+
+    // Policies are checked before anything is written, so that an error comes alone
+    if (!resolvePolicies()) return -1;
+
+    // Machine-readable output: records go through a buffered writer, ending with a summary
+    RecordWriter::Format record_format = RecordWriter::Format::Jsonl;
+    std::unique_ptr<RecordWriter> records;
+    if (RecordWriter::parseFormat(output_format_, record_format)) {
+        records = std::make_unique<RecordWriter>(*out_, record_format, max_output_bytes_, max_records_);
+        records->header();
+    }
+    record_writer_ = records.get();
+    kernels_ = selectKernels();
+
+    // Progress reports are driven by the bytes the readers consume (see advanceProgress)
+    std::unique_ptr<Progress> progress;
+    if (progress_enabled_) {
+        progress = std::make_unique<Progress>(*err_, inputBytes(), err_ == &std::cerr && isatty(STDERR_FILENO));
+        progress_ = progress.get();
+        progress_next_ = Progress::kCheckBytes;
+    }
+    if (binary) {
+        if (!compareArrayInputs(fin1, fin2, format1, format2)) {
+            record_writer_ = nullptr;
+            progress_ = nullptr;
+            progress_next_ = UINT64_MAX;
+            return -1;
+        }
+    } else if (blocks_) {
+        compareBlocks(fin1, fin2);
+    } else if (wide_row_columns_ > 0) {
+        compareWideRows(fin1, fin2);
+    } else if (block_index_path_.empty() && parsed1_ && parsed2_) {
+        compareParsed(*parsed1_, *parsed2_);
+    } else if (block_index_path_.empty()) {
+        compareStreams(fin1, fin2);
+    } else {
+        compareIndexedBlocks(fin1, fin2);
+    }
+    if (progress) {
+        progress->finish(progress_bytes_, lines_compared_, diff_lines_);
+        progress_ = nullptr;
+        progress_next_ = UINT64_MAX;
+    }
+
+    if (records) {
+        record_writer_ = nullptr;
+        records->summary({file1_, file2_, lines_compared_, diff_lines_, max_percentage_error_});
+        return static_cast<int>(diff_lines_);
+    }
+
+    if (quiet_) {
+        // Print nothing if files are equal, otherwise print as normal (with all options except quiet)
+        if (diff_lines_ == 0) {
+            return 0;
+        } else {
+            // Print summary as in only_equal_ mode
+            *out_ << "Comparing " << file1_ << " and " << file2_ << "\n";
+            *out_ << "Tolerance: " << tol_ << ", Threshold: " << threshold_ << "\n";
+            *out_ << "Files DIFFER: " << diff_lines_ << " lines differ, max percentage error: " << max_percentage_error_ << "%\n";
+        }
+        return static_cast<int>(diff_lines_);
+    }
+
+    if (only_equal_) {
+        *out_ << "Comparing " << file1_ << " and " << file2_ << "\n";
+        *out_ << "Tolerance: " << tol_ << ", Threshold: " << threshold_ << "\n";
+        if (diff_lines_ == 0) {
+            *out_ << "Files are EQUAL within tolerance.\n";
+            return 0;
+        } else {
+            *out_ << "Files DIFFER: " << diff_lines_ << " lines differ, max percentage error: " << max_percentage_error_ << "%\n";
+        }
+    }
+    return static_cast<int>(diff_lines_);
+}
+
+// Check that both files exist and open them; errors are reported on err_
+bool NumericDiff::openFiles(std::ifstream& fin1, std::ifstream& fin2) const {
+    fin1.open(resolvePath(file1_));
+    fin2.open(resolvePath(file2_));
 
     // Check if files exist before trying to open
     bool fileProblem = false;
-    std::ifstream test1(file1_);
+    std::ifstream test1(resolvePath(file1_));
     if (!test1.good()) {
-        std::cerr << "Error: '" << file1_ << "' does not exist or cannot be accessed.\n";
+        *err_ << "Error: '" << file1_ << "' does not exist or cannot be accessed.\n";
         fileProblem = true;
     }
-    std::ifstream test2(file2_);
+    std::ifstream test2(resolvePath(file2_));
     if (!test2.good()) {
-        std::cerr << "Error: '" << file2_ << "' does not exist or cannot be accessed.\n";
+        *err_ << "Error: '" << file2_ << "' does not exist or cannot be accessed.\n";
         fileProblem = true;
     }
-    if (fileProblem) {
-        return -1; // Error code for file access issues
-    }
+    if (fileProblem) return false;
 
     // Check if files can be opened
-    fileProblem = false;
     if (!fin1.is_open()) {
-        std::cerr << "Error: Cannot open file '" << file1_ << "'\n";
+        *err_ << "Error: Cannot open file '" << file1_ << "'\n";
         fileProblem = true;
     }
     if (!fin2.is_open()) {
-        std::cerr << "Error: Cannot open file '" << file2_ << "'\n";
+        *err_ << "Error: Cannot open file '" << file2_ << "'\n";
         fileProblem = true;
     }
-    if (fileProblem) {  
-        return -1; // Error code for file access issues
+    return !fileProblem;
+}
+
+// Helper: read the next line that is not a comment
+bool NumericDiff::readDataLine(std::istream& in, std::string& line) const {
+    while (std::getline(in, line)) {
+        if (profiler_) profiler_->addBytes(line.size() + 1);
+        advanceProgress(line.size() + 1);
+        if (comment_char_.empty() || !isLineComment(line)) return true;
     }
+    line.clear();
+    return false;
+}
 
+// Compare two streams line by line; a file that ends first is compared as empty lines
+void NumericDiff::compareStreams(std::istream& in1, std::istream& in2) {
     std::string line1, line2;
-    size_t total_lines = 0;
     bool file1_has_line = true, file2_has_line = true;
     while (true) {
-        // Advance file1 to next non-comment line
-        while (file1_has_line) {
-            if (!std::getline(fin1, line1)) {
-                file1_has_line = false;
-                line1.clear();
-                break;
-            }
-            if (comment_char_.empty() || !isLineComment(line1)) break;
-        }
-        // Advance file2 to next non-comment line
-        while (file2_has_line) {
-            if (!std::getline(fin2, line2)) {
-                file2_has_line = false;
-                line2.clear();
-                break;
-            }
-            if (comment_char_.empty() || !isLineComment(line2)) break;
+        {
+            Profiler::Scope scope(profiler_, Profiler::kRead);
+            if (file1_has_line) file1_has_line = readDataLine(in1, line1);
+            if (file2_has_line) file2_has_line = readDataLine(in2, line2);
         }
         if (!file1_has_line && !file2_has_line) break;
-        ++total_lines;
         compareLine(line1, line2);
     }
-    while (std::getline(fin1, line1)) {
-        if (!comment_char_.empty() && isLineComment(line1)) continue;
-        ++total_lines;
-        compareLine(line1, "");
+}
+
+// Compare two parsed inputs line by line, as compareStreams() does; the kernel gets the
+// fields and values of each line from the inputs instead of tokenizing and parsing it
+void NumericDiff::compareParsed(const ParsedText& in1, const ParsedText& in2) {
+    std::vector<std::string_view>& tokens1 = scratch_.tokens1;
+    std::vector<std::string_view>& tokens2 = scratch_.tokens2;
+    RowValues& values = scratch_.row_values;
+    const size_t lines = std::max(in1.lines(), in2.lines());
+    for (size_t i = 0; i < lines; ++i) {
+        {
+            Profiler::Scope scope(profiler_, Profiler::kTokenize);
+            gatherFields(in1, i, tokens1, values.values1, values.numeric1);
+            gatherFields(in2, i, tokens2, values.values2, values.numeric2);
+        }
+        LineResult result;
+        (this->*kernels_.tokens)(tokens1, tokens2, result, &values);
+        recordLine(result);
+    }
+}
+
+// Helper: collect the fields of a line of a parsed input, keeping only the columns
+// selected with -C; a missing line has no fields, like an empty line
+void NumericDiff::gatherFields(const ParsedText& in, size_t line, std::vector<std::string_view>& tokens,
+                               std::vector<double>& values, std::vector<bool>& numeric) const {
+    tokens.clear();
+    values.clear();
+    numeric.clear();
+    if (line >= in.lines()) return;
+    const uint64_t bytes = in.line(line).size() + 1;
+    if (profiler_) profiler_->addBytes(bytes);
+    advanceProgress(bytes);
+    const size_t first = in.first_field[line];
+    for (size_t f = first; f < in.first_field[line + 1]; ++f) {
+        size_t column = f - first;
+        if (!column_mask_.empty()) {
+            if (column >= column_mask_.size()) break;
+            if (!column_mask_[column]) continue;
+        }
+        const ParsedText::Field& field = in.fields[f];
+        tokens.push_back(in.field(field));
+        values.push_back(field.value);
+        numeric.push_back(field.numeric);
+    }
+}
+
+// Compare two streams in wide-row mode: each line is read and compared in segments of
+// wide_row_columns_ columns, so no full line is ever held in memory. Column numbers
+// (for -C) and per-line statistics are the same as in line mode.
+void NumericDiff::compareWideRows(std::istream& in1, std::istream& in2) {
+    FieldReader reader1(in1), reader2(in2);
+    std::vector<std::string_view> segment1, segment2;
+    bool file1_has_line = true, file2_has_line = true;
+    uint64_t bytes_read = 0;  // Reader offsets at the last progress update
+    while (true) {
+        {
+            Profiler::Scope scope(profiler_, Profiler::kRead);
+            if (file1_has_line) file1_has_line = reader1.nextLine(comment_char_);
+            if (file2_has_line) file2_has_line = reader2.nextLine(comment_char_);
+        }
+        if (!file1_has_line && !file2_has_line) break;
+
+        LineResult result;
+        column_offset_ = 0;
+        for (size_t first_column = 0;; first_column += wide_row_columns_) {
+            size_t scanned1 = 0, scanned2 = 0;
+            segment1.clear();
+            segment2.clear();
+            {
+                // Reading and splitting fields is one pass here; it is counted as tokenizing
+                Profiler::Scope scope(profiler_, Profiler::kTokenize);
+                if (file1_has_line) scanned1 = reader1.readFields(wide_row_columns_, column_mask_, first_column, segment1);
+                if (file2_has_line) scanned2 = reader2.readFields(wide_row_columns_, column_mask_, first_column, segment2);
+            }
+            // Nothing left to pair in a continuation segment
+            if (first_column > 0 && (scanned1 == 0 || scanned2 == 0)) break;
+            (this->*kernels_.tokens)(segment1, segment2, result, nullptr);
+            column_offset_ += std::min(segment1.size(), segment2.size());
+            // One of the lines ended: the remaining columns are not compared
+            if (scanned1 < wide_row_columns_ || scanned2 < wide_row_columns_) break;
+        }
+        if (file1_has_line) reader1.skipLine();
+        if (file2_has_line) reader2.skipLine();
+        recordLine(result);
+        uint64_t offset = reader1.bytesRead() + reader2.bytesRead();
+        advanceProgress(offset - bytes_read);
+        bytes_read = offset;
+    }
+    if (profiler_) profiler_->addBytes(reader1.bytesRead() + reader2.bytesRead());
+}
+
+// Helper: read the next block of non-comment lines; blocks are separated by one or more
+// blank lines. Returns false (with an empty block) at end of file. The separators are
+// counted, so that line numbers stay the same as in line mode.
+bool NumericDiff::readBlock(std::istream& in, std::vector<std::string>& block, size_t& leading,
+                            size_t& trailing) const {
+    block.clear();
+    leading = 0;
+    trailing = 0;
+    std::string line;
+    while (readDataLine(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            if (block.empty()) {
+                ++leading;  // Leading or repeated separators
+                continue;
+            }
+            trailing = 1;
+            return true;
+        }
+        block.push_back(line);
+    }
+    return !block.empty();
+}
+
+// Compare one pair of blocks on a private copy of this object, so that workers share
+// no mutable state. Output and statistics are collected in the job.
+void NumericDiff::compareBlock(BlockJob& job) const {
+    std::ostringstream output;
+    NumericDiff worker(*this);
+    worker.out_ = &output;
+    worker.progress_ = nullptr;  // Blocks are read, and progress reported, by the main thread
+    worker.progress_next_ = UINT64_MAX;
+    worker.diff_lines_ = 0;
+    worker.max_percentage_error_ = 0.0;
+    worker.lines_compared_ = job.first_line;
+    worker.fast_path_cells_ = 0;
+    job.column_stats.clear();
+    if (column_stats_) worker.column_stats_ = &job.column_stats;
+    // Records are collected uncapped here; the caps apply when they are copied in file order
+    std::unique_ptr<RecordWriter> records;
+    if (record_writer_) {
+        RecordWriter::Format format = RecordWriter::Format::Jsonl;
+        RecordWriter::parseFormat(output_format_, format);
+        records = std::make_unique<RecordWriter>(output, format);
+        worker.record_writer_ = records.get();
     }
-    while (std::getline(fin2, line2)) {
-        if (!comment_char_.empty() && isLineComment(line2)) continue;
-        ++total_lines;
-        compareLine("", line2);
+    size_t n = std::max(job.lines1.size(), job.lines2.size());
+    const std::string empty;
+    for (size_t i = 0; i < n; ++i) {
+        worker.compareLine(i < job.lines1.size() ? job.lines1[i] : empty,
+                           i < job.lines2.size() ? job.lines2[i] : empty);
     }
+    if (records) records->flush();
+    job.output = output.str();
+    job.diff_lines = worker.diff_lines_;
+    job.max_error = worker.max_percentage_error_;
+    job.fast_path_cells = worker.fast_path_cells_;
+}
 
-    if (quiet_) {
-        // Print nothing if files are equal, otherwise print as normal (with all options except quiet)
-        if (diff_lines_ == 0) {
-            return 0;
-        } else {
-            // Print summary as in only_equal_ mode
-            std::cout << "Comparing " << file1_ << " and " << file2_ << "\n";
-            std::cout << "Tolerance: " << tol_ << ", Threshold: " << threshold_ << "\n";
-            std::cout << "Files DIFFER: " << diff_lines_ << " lines differ, max percentage error: " << max_percentage_error_ << "%\n";
+// Compare two streams block by block (gnuplot index style). Blocks are read in batches,
+// compared in parallel on a worker pool, and reported in file order, each differing
+// block followed by its own summary. Blocks are numbered from 0, like gnuplot indices.
+void NumericDiff::compareBlocks(std::istream& in1, std::istream& in2) {
+    ThreadPool pool(ThreadPool::resolveJobs(jobs_));
+    const size_t batch_size = std::max<size_t>(pool.size(), 1) * 4;
+    std::vector<BlockJob> batch(batch_size);
+    size_t block_number = 0;
+    bool file1_has_block = true, file2_has_block = true;
+    while (file1_has_block || file2_has_block) {
+        size_t count = 0;
+        {
+            Profiler::Scope scope(profiler_, Profiler::kRead);
+            while (count < batch_size) {
+                BlockJob& job = batch[count];
+                size_t leading1 = 0, trailing1 = 0, leading2 = 0, trailing2 = 0;
+                file1_has_block = file1_has_block && readBlock(in1, job.lines1, leading1, trailing1);
+                file2_has_block = file2_has_block && readBlock(in2, job.lines2, leading2, trailing2);
+                if (!file1_has_block) job.lines1.clear();
+                if (!file2_has_block) job.lines2.clear();
+                // Blank lines count as data lines, as in line mode
+                lines_compared_ += std::max(leading1, leading2);
+                if (!file1_has_block && !file2_has_block) break;
+                job.first_line = lines_compared_;
+                lines_compared_ += std::max(job.lines1.size(), job.lines2.size()) + std::max(trailing1, trailing2);
+                ++count;
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            BlockJob& job = batch[i];
+            pool.submit([this, &job] { compareBlock(job); });
+        }
+        pool.wait();
+        for (size_t i = 0; i < count; ++i, ++block_number) {
+            const BlockJob& job = batch[i];
+            fast_path_cells_ += job.fast_path_cells;
+            if (record_writer_) {
+                record_writer_->append(job.output);
+            } else {
+                *out_ << job.output;
+            }
+            if (job.diff_lines == 0) continue;
+            diff_lines_ += job.diff_lines;
+            if (job.max_error > max_percentage_error_) max_percentage_error_ = job.max_error;
+            if (column_stats_) mergeColumnStats(job.column_stats);
+            if (record_writer_) continue;
+            *out_ << "Block " << block_number << ": " << job.diff_lines
+                  << " lines differ, max percentage error: " << job.max_error << "%\n";
         }
-        return static_cast<int>(diff_lines_);
     }
+}
 
-    if (only_equal_) {
-        std::cout << "Comparing " << file1_ << " and " << file2_ << "\n";
-        std::cout << "Tolerance: " << tol_ << ", Threshold: " << threshold_ << "\n";
-        if (diff_lines_ == 0) {
-            std::cout << "Files are EQUAL within tolerance.\n";
-            return 0;
+// Compare two streams in blocks of block_size_ lines. Block pairs whose fingerprints
+// were verified equal at the same position in a previous run are skipped; the entry of
+// every other position is replaced by the outcome of this run, and the index is saved
+// at the end.
+void NumericDiff::compareIndexedBlocks(std::istream& in1, std::istream& in2) {
+    BlockIndex index(resolvePath(block_index_path_), block_size_, optionsSignature());
+    index.load();
+    const uint64_t files = filesSignature();
+    size_t block = 0;
+    // In plain side-by-side mode every line is printed, so nothing can be skipped
+    bool can_skip = only_equal_ || !side_by_side_ || suppress_common_lines_;
+
+    std::vector<std::string> block1, block2;
+    std::string line;
+    while (true) {
+        block1.clear();
+        block2.clear();
+        {
+            Profiler::Scope scope(profiler_, Profiler::kRead);
+            while (block1.size() < block_size_ && readDataLine(in1, line)) block1.push_back(line);
+            while (block2.size() < block_size_ && readDataLine(in2, line)) block2.push_back(line);
+        }
+        if (block1.empty() && block2.empty()) break;
+
+        const size_t number = block++;
+        if (block1.size() != block2.size()) {
+            index.forget(files, number);
+            // Tail of files with different lengths: compare against empty lines, do not index
+            size_t n = std::max(block1.size(), block2.size());
+            for (size_t i = 0; i < n; ++i) {
+                compareLine(i < block1.size() ? block1[i] : std::string(),
+                            i < block2.size() ? block2[i] : std::string());
+            }
+            continue;
+        }
+        BlockIndex::Fingerprint print1 = BlockIndex::hashLines(block1);
+        BlockIndex::Fingerprint print2 = BlockIndex::hashLines(block2);
+        if (can_skip && index.isVerifiedEqual(files, number, print1, print2)) {
+            ++skipped_blocks_;
+            lines_compared_ += block1.size();
+            continue;
+        }
+        size_t diff_lines_before = diff_lines_;
+        for (size_t i = 0; i < block1.size(); ++i) compareLine(block1[i], block2[i]);
+        if (diff_lines_ == diff_lines_before) {
+            index.markEqual(files, number, print1, print2);
         } else {
-            std::cout << "Files DIFFER: " << diff_lines_ << " lines differ, max percentage error: " << max_percentage_error_ << "%\n";
+            index.forget(files, number);
         }
     }
-    return static_cast<int>(diff_lines_);
+    index.truncate(files, block);
+    if (!index.save()) {
+        *err_ << "Warning: cannot write block index '" << block_index_path_ << "'\n";
+    }
+}
+
+// Helper: count a cell over tolerance in the statistics of its input column
+void NumericDiff::recordColumnStats(size_t k, double error) const {
+    size_t column = selected_columns_.empty() ? k : selected_columns_[k] - 1;
+    if (column >= column_stats_->size()) column_stats_->resize(column + 1);
+    ColumnStats& stats = (*column_stats_)[column];
+    if (stats.differing_cells++ == 0) stats.first_line = lines_compared_ + 1;
+    if (std::abs(error) > stats.max_error) stats.max_error = std::abs(error);
+}
+
+// Helper: merge the column statistics of a later block into column_stats_
+void NumericDiff::mergeColumnStats(const std::vector<ColumnStats>& stats) const {
+    if (stats.size() > column_stats_->size()) column_stats_->resize(stats.size());
+    for (size_t c = 0; c < stats.size(); ++c) {
+        ColumnStats& total = (*column_stats_)[c];
+        if (stats[c].differing_cells == 0) continue;
+        if (total.differing_cells == 0) total.first_line = stats[c].first_line;
+        total.differing_cells += stats[c].differing_cells;
+        if (stats[c].max_error > total.max_error) total.max_error = stats[c].max_error;
+    }
+}
+
+// Helper: pass the counters to the progress report and set the next checkpoint
+void NumericDiff::reportProgress() const {
+    progress_->update(progress_bytes_, lines_compared_, diff_lines_);
+    progress_next_ = progress_bytes_ + Progress::kCheckBytes;
+}
+
+// Helper: total size of both inputs (in-memory arrays or data, or files), 0 if unknown
+uint64_t NumericDiff::inputBytes() const {
+    if (has_input_arrays_) {
+        return (input_array1_.rows * input_array1_.columns + input_array2_.rows * input_array2_.columns) *
+               sizeof(double);
+    }
+    if (has_input_data_) return input_data1_.size() + input_data2_.size();
+    std::error_code ec1, ec2;
+    uintmax_t size1 = std::filesystem::file_size(resolvePath(file1_), ec1);
+    uintmax_t size2 = std::filesystem::file_size(resolvePath(file2_), ec2);
+    if (ec1 || ec2) return 0;
+    return size1 + size2;
+}
+
+// Resolve the per-column policies into a flat array indexed by compared column, so that
+// the comparison loop does no lookups. Rules from the policy file come first; later
+// rules override earlier ones for the same column.
+bool NumericDiff::resolvePolicies() {
+    default_policy_ = ColumnPolicy{ColumnPolicy::Mode::Relative, tol_, threshold_};
+    column_policies_.clear();
+    std::vector<ColumnPolicyRule> rules;
+    std::string error;
+    if (!policy_file_.empty() && !ColumnPolicyRule::load(resolvePath(policy_file_), rules, error)) {
+        *err_ << "Error: " << error << "\n";
+        return false;
+    }
+    for (const auto& spec : column_policy_specs_) {
+        ColumnPolicyRule rule;
+        if (!ColumnPolicyRule::parse(spec, rule, error)) {
+            *err_ << "Error: " << error << "\n";
+            return false;
+        }
+        rules.push_back(rule);
+    }
+    if (rules.empty()) return true;
+
+    // Policy of each 1-based input column that has one
+    size_t last_column = 0;
+    for (const auto& rule : rules) last_column = std::max(last_column, *rule.columns.rbegin());
+    std::vector<ColumnPolicy> by_column(last_column, default_policy_);
+    for (const auto& rule : rules) {
+        ColumnPolicy policy{rule.mode, rule.tolerance.value_or(tol_), rule.threshold.value_or(threshold_)};
+        for (size_t column : rule.columns) by_column[column - 1] = policy;
+    }
+    if (selected_columns_.empty()) {
+        column_policies_ = by_column;
+    } else {
+        for (size_t column : selected_columns_) {
+            column_policies_.push_back(column <= by_column.size() ? by_column[column - 1] : default_policy_);
+        }
+    }
+    return true;
+}
+
+// Hash the options that decide equality, so a stale index is never reused
+uint64_t NumericDiff::optionsSignature() const {
+    std::ostringstream oss;
+    oss << std::setprecision(17) << "tol=" << tol_ << ";threshold=" << threshold_
+        << ";comment=" << comment_char_ << ";columns=";
+    for (size_t col : columns_to_compare_) oss << col << ',';
+    oss << ";policies=";
+    for (const ColumnPolicy& policy : column_policies_) {
+        oss << static_cast<int>(policy.mode) << ':' << policy.tolerance << ':' << policy.threshold << ',';
+    }
+    return BlockIndex::hash(oss.str());
+}
+
+// Hash the absolute paths of the compared files: one index can serve several file pairs
+uint64_t NumericDiff::filesSignature() const {
+    std::error_code ec1, ec2;
+    std::filesystem::path path1 = std::filesystem::absolute(resolvePath(file1_), ec1);
+    std::filesystem::path path2 = std::filesystem::absolute(resolvePath(file2_), ec2);
+    std::string paths = (ec1 ? resolvePath(file1_) : path1.string()) + '\0' +
+                        (ec2 ? resolvePath(file2_) : path2.string());
+    return BlockIndex::hash(paths);
 }
 
 // Helper: count columns in a file (used for formatting)
@@ -150,161 +651,444 @@ uint NumericDiff::filesColumns(const std::string& file) const {
     return count;
 }
 
-// Helper: check if a string is numeric
-bool NumericDiff::isNumeric(const std::string& str) const {
+// Helper: parse a token as a number; true only if the whole token is numeric.
+// Tokens are views into a line and always end at whitespace or at the end of the
+// line, so strtod never reads past them.
+bool NumericDiff::parseNumber(std::string_view token, double& value) const {
     char* end = nullptr;
-    std::strtod(str.c_str(), &end);
-    return end != str.c_str() && *end == '\0';
+    value = std::strtod(token.data(), &end);
+    return end != token.data() && end == token.data() + token.size();
 }
 
-// Helper: tokenize a line into a vector of strings
-static std::vector<std::string> tokenize(const std::string& line) {
-    std::istringstream iss(line);
-    std::vector<std::string> tokens;
-    std::string token;
-    while (iss >> token) tokens.push_back(token);
-    return tokens;
+// Helper: split a line into whitespace-separated tokens (views into the line, no copies)
+static void tokenize(std::string_view line, std::vector<std::string_view>& tokens) {
+    tokens.clear();
+    size_t pos = 0;
+    const size_t size = line.size();
+    while (true) {
+        while (pos < size && FieldReader::isSpace(line[pos])) ++pos;
+        if (pos == size) return;
+        size_t start = pos;
+        while (pos < size && !FieldReader::isSpace(line[pos])) ++pos;
+        tokens.push_back(line.substr(start, pos - start));
+    }
+}
+
+// Helper: split a line keeping only the columns selected in mask (mask[i] is column i + 1).
+// Unselected fields are skipped without being materialized or parsed, and scanning
+// stops right after the last selected column.
+static void tokenizeProjected(std::string_view line, const std::vector<bool>& mask,
+                              std::vector<std::string_view>& tokens) {
+    tokens.clear();
+    size_t pos = 0;
+    const size_t size = line.size();
+    for (size_t column = 0; column < mask.size(); ++column) {
+        while (pos < size && FieldReader::isSpace(line[pos])) ++pos;
+        if (pos == size) return;
+        size_t start = pos;
+        while (pos < size && !FieldReader::isSpace(line[pos])) ++pos;
+        if (mask[column]) tokens.push_back(line.substr(start, pos - start));
+    }
+}
+
+// Compare inputs when at least one of them is a binary array. Binary arrays are
+// memory-mapped (or given with setInputArrays); shapes must match (rows, and columns
+// of every text line).
+bool NumericDiff::compareArrayInputs(std::istream& in1, std::istream& in2,
+                                     ArrayFile::Format format1, ArrayFile::Format format2) {
+    ArrayFile file1, file2;
+    ArrayView array1 = input_array1_, array2 = input_array2_;
+    if (!has_input_arrays_) {
+        std::string error;
+        if ((format1 != ArrayFile::Format::Text && !file1.open(resolvePath(file1_), format1, raw_columns_, error)) ||
+            (format2 != ArrayFile::Format::Text && !file2.open(resolvePath(file2_), format2, raw_columns_, error))) {
+            *err_ << "Error: " << error << "\n";
+            return false;
+        }
+        array1 = file1.view();
+        array2 = file2.view();
+        if (format1 == ArrayFile::Format::Text) return compareTextWithArray(in1, file1_, array2, file2_, true);
+        if (format2 == ArrayFile::Format::Text) return compareTextWithArray(in2, file2_, array1, file1_, false);
+    }
+
+    if (array1.rows != array2.rows || array1.columns != array2.columns) {
+        *err_ << "Error: Shape mismatch: '" << file1_ << "' is " << array1.rows << "x"
+                  << array1.columns << ", '" << file2_ << "' is " << array2.rows << "x"
+                  << array2.columns << "\n";
+        return false;
+    }
+    compareBinaryRows(array1, array2);
+    return true;
+}
+
+// Compare two binary arrays row by row. Values go straight into percentageDifference(),
+// with no formatting or parsing; only rows that are printed are formatted and handed
+// to the token kernel (which recomputes the same errors from the exact round-trip text).
+void NumericDiff::compareBinaryRows(const ArrayView& array1, const ArrayView& array2) {
+    const size_t columns = array1.columns;
+    std::vector<size_t> selected;
+    for (size_t j = 0; j < columns; ++j) {
+        if (column_mask_.empty() || (j < column_mask_.size() && column_mask_[j])) selected.push_back(j);
+    }
+    const bool print_every_row = !only_equal_ && side_by_side_ && !suppress_common_lines_;
+    const bool policies = !column_policies_.empty();
+    if (profiler_) profiler_->addBytes(2 * array1.rows * columns * sizeof(double));
+    std::string storage1, storage2;
+    std::vector<std::string_view> tokens1, tokens2;
+    for (size_t r = 0; r < array1.rows; ++r) {
+        const double* values1 = array1.data + r * array1.row_stride;
+        const double* values2 = array2.data + r * array2.row_stride;
+        advanceProgress(2 * columns * sizeof(double));
+        LineResult result;
+        {
+            Profiler::Scope scope(profiler_, Profiler::kCompare);
+            for (size_t k = 0; k < selected.size(); ++k) {
+                size_t j = selected[k];
+                double diff = 0.0;
+                double value1 = values1[j * array1.column_stride];
+                double value2 = values2[j * array2.column_stride];
+                if (policies) {
+                    if (!policyFor(k).differs(value1, value2, diff)) continue;
+                } else {
+                    diff = std::abs(percentageDifference(value1, value2));
+                    if (!(diff > tol_)) continue;
+                }
+                result.any_error = true;
+                if (diff > result.max_error) result.max_error = diff;
+                if (column_stats_) recordColumnStats(k, diff);
+            }
+        }
+        if (only_equal_ || !(result.any_error || print_every_row)) {
+            recordLine(result);
+            continue;
+        }
+        formatRow(array1, r, storage1, tokens1);
+        formatRow(array2, r, storage2, tokens2);
+        LineResult printed;
+        // Column statistics of this row were collected above
+        std::vector<ColumnStats>* column_stats = column_stats_;
+        column_stats_ = nullptr;
+        (this->*kernels_.tokens)(tokens1, tokens2, printed, nullptr);
+        column_stats_ = column_stats;
+        recordLine(printed);
+    }
+}
+
+// Compare a text file with a binary array: each data line of the text must have as
+// many columns as the array, and there must be one line per array row. The binary row
+// is formatted and the pair goes through the token kernel, so non-numeric text tokens
+// behave as in text-to-text comparisons.
+bool NumericDiff::compareTextWithArray(std::istream& text, const std::string& text_path,
+                                       const ArrayView& array, const std::string& array_path,
+                                       bool text_first) {
+    std::string line, storage;
+    std::vector<std::string_view> all_tokens, text_tokens, array_tokens;
+    size_t row = 0;
+    while (readDataLine(text, line)) {
+        tokenize(line, all_tokens);
+        if (row >= array.rows || all_tokens.size() != array.columns) {
+            *err_ << "Error: Shape mismatch: data line " << row + 1 << " of '" << text_path
+                      << "' has " << all_tokens.size() << " columns, '" << array_path << "' is "
+                      << array.rows << "x" << array.columns << "\n";
+            return false;
+        }
+        text_tokens.clear();
+        for (size_t j = 0; j < all_tokens.size(); ++j) {
+            if (column_mask_.empty() || (j < column_mask_.size() && column_mask_[j])) {
+                text_tokens.push_back(all_tokens[j]);
+            }
+        }
+        formatRow(array, row, storage, array_tokens);
+        LineResult result;
+        if (text_first) {
+            (this->*kernels_.tokens)(text_tokens, array_tokens, result, nullptr);
+        } else {
+            (this->*kernels_.tokens)(array_tokens, text_tokens, result, nullptr);
+        }
+        recordLine(result);
+        advanceProgress(array.columns * sizeof(double));
+        ++row;
+    }
+    if (row != array.rows) {
+        *err_ << "Error: Shape mismatch: '" << text_path << "' has " << row << " data lines, '"
+                  << array_path << "' has " << array.rows << " rows\n";
+        return false;
+    }
+    return true;
+}
+
+// Helper: format the selected values of a binary row as tokens, in shortest round-trip
+// form. Tokens are NUL-terminated in storage, so they can be parsed like text tokens.
+void NumericDiff::formatRow(const ArrayView& array, size_t row, std::string& storage,
+                            std::vector<std::string_view>& tokens) const {
+    const size_t n = array.columns;
+    const size_t kMaxToken = 32;  // Shortest round-trip form of a double, plus NUL
+    storage.clear();
+    tokens.clear();
+    // Reserved up front, so that the views stay valid while the row is appended
+    storage.reserve(n * kMaxToken);
+    for (size_t j = 0; j < n; ++j) {
+        if (!column_mask_.empty() && (j >= column_mask_.size() || !column_mask_[j])) continue;
+        char* begin = storage.data() + storage.size();
+        char buffer[kMaxToken];
+        auto res = std::to_chars(buffer, buffer + sizeof(buffer), array.at(row, j));
+        storage.append(buffer, res.ptr);
+        storage.push_back('\0');
+        tokens.emplace_back(begin, static_cast<size_t>(res.ptr - buffer));
+    }
 }
 
 // Helper: calculate column widths for side-by-side output
-static std::vector<size_t> calc_col_widths(const std::vector<std::string>& t1, const std::vector<std::string>& t2) {
+static void calc_col_widths(const std::vector<std::string_view>& t1, const std::vector<std::string_view>& t2,
+                            std::vector<size_t>& col_widths) {
     size_t n = std::min(t1.size(), t2.size());
-    std::vector<size_t> col_widths(n, 0);
+    col_widths.resize(n);
     for (size_t i = 0; i < n; ++i) {
         col_widths[i] = std::max(t1[i].size(), t2[i].size());
     }
-    return col_widths;
 }
 
-// Compare two lines, print differences according to options
-void NumericDiff::compareLine(const std::string& line1, const std::string& line2) const {
-    // Tokenize both lines
-    std::vector<std::string> tokens1 = tokenize(line1);
-    std::vector<std::string> tokens2 = tokenize(line2);
-    std::vector<std::string> output1, output2, errors;
-    std::vector<bool> is_diff;
-    std::string toPrint1, toPrint2, toPrintErrors;
+// Pick the comparison kernel specialised for the current option combination
+NumericDiff::Kernels NumericDiff::selectKernels() const {
+    return pickKernels(!columns_to_compare_.empty(), color_diff_digits_, only_equal_, side_by_side_,
+                       suppress_common_lines_, record_writer_ != nullptr);
+}
+
+// Resolve the run-time flags one at a time into template arguments
+template <bool... Fixed>
+NumericDiff::Kernels NumericDiff::pickKernels() {
+    return kernelsFor<Fixed...>();
+}
+
+// Kernels of one flag combination. Options that cannot affect the output in a mode are
+// normalised away first, so that equivalent combinations share one instantiation and
+// only 16 kernels are compiled: summaries print nothing per line, records replace the
+// text layout, and -s only matters side by side.
+template <bool Columns, bool ColorDigits, bool SummaryOnly, bool SideBySide,
+          bool SuppressCommon, bool Records>
+NumericDiff::Kernels NumericDiff::kernelsFor() {
+    constexpr bool kRecords = Records && !SummaryOnly;
+    constexpr bool kText = !SummaryOnly && !kRecords;
+    constexpr bool kSideBySide = kText && SideBySide;
+    using Mode = LineMode<Columns, kText && ColorDigits, SummaryOnly, kSideBySide,
+                          kSideBySide && SuppressCommon, kRecords>;
+    return {&NumericDiff::compareLineKernel<Mode>, &NumericDiff::compareTokensKernel<Mode>};
+}
+
+template <bool... Fixed, typename... Rest>
+NumericDiff::Kernels NumericDiff::pickKernels(bool next, Rest... rest) {
+    return next ? pickKernels<Fixed..., true>(rest...) : pickKernels<Fixed..., false>(rest...);
+}
+
+// Update the summary statistics with the outcome of one line
+void NumericDiff::recordLine(const LineResult& result) const {
+    ++lines_compared_;
+    if (profiler_) profiler_->addLines(1);
+    if (result.any_error) {
+        ++diff_lines_;
+        if (result.max_error > max_percentage_error_) max_percentage_error_ = result.max_error;
+    }
+}
 
-    // Calculate column widths for pretty output
-    std::vector<size_t> col_widths = calc_col_widths(tokens1, tokens2);
-    size_t n = col_widths.size();
+// Compare two lines: tokenize them and hand the tokens to the matching token kernel
+template <class Mode>
+void NumericDiff::compareLineKernel(const std::string& line1, const std::string& line2) const {
+    // Tokenize both lines; with -C only the selected columns are kept
+    std::vector<std::string_view>& tokens1 = scratch_.tokens1;
+    std::vector<std::string_view>& tokens2 = scratch_.tokens2;
+    {
+        Profiler::Scope scope(profiler_, Profiler::kTokenize);
+        if constexpr (Mode::kColumns) {
+            tokenizeProjected(line1, column_mask_, tokens1);
+            tokenizeProjected(line2, column_mask_, tokens2);
+        } else {
+            tokenize(line1, tokens1);
+            tokenize(line2, tokens2);
+        }
+    }
+    LineResult result;
+    compareTokensKernel<Mode>(tokens1, tokens2, result, nullptr);
+    recordLine(result);
+}
 
+// Compare two rows of tokens (a whole line, or a segment of a wide line) and print
+// differences according to the output mode. The first pass only computes the
+// per-column errors; output strings are built in a second pass, and only for rows
+// that are actually printed. With parsed values (see RowValues), tokens are not parsed.
+template <class Mode>
+void NumericDiff::compareTokensKernel(const std::vector<std::string_view>& tokens1,
+                                      const std::vector<std::string_view>& tokens2,
+                                      LineResult& result, const RowValues* parsed) const {
+    size_t n = std::min(tokens1.size(), tokens2.size());
+    auto value1 = [&](size_t i, double& value) {
+        if (parsed) {
+            value = parsed->values1[i];
+            return static_cast<bool>(parsed->numeric1[i]);
+        }
+        return parseNumber(tokens1[i], value);
+    };
+    auto value2 = [&](size_t i, double& value) {
+        if (parsed) {
+            value = parsed->values2[i];
+            return static_cast<bool>(parsed->numeric2[i]);
+        }
+        return parseNumber(tokens2[i], value);
+    };
+
+    // Percentage error of each compared column that exceeds the tolerance
+    std::vector<double>& column_errors = scratch_.column_errors;
+    std::vector<bool>& is_diff = scratch_.is_diff;
+    column_errors.assign(n, 0.0);
+    is_diff.assign(n, false);
     bool any_error = false;
-    double max_diff_this_line = 0.0;
-    for (size_t i = 0; i < n; ++i) {
-        if (!columns_to_compare_.empty() && columns_to_compare_.count(i + 1) == 0) {
-            // Skip this column entirely (do not print)
-            continue;
+    const bool policies = !column_policies_.empty();
+    auto compareColumn = [&](size_t i, double v1, double v2) {
+        double diff = 0.0;
+        if (policies) {
+            if (!policyFor(column_offset_ + i).differs(v1, v2, diff)) return;
+        } else {
+            diff = percentageDifference(v1, v2);
+            if (!(std::abs(diff) > tol_)) return;
         }
-        // Compare only if both tokens are numeric
-        if (isNumeric(tokens1[i]) && isNumeric(tokens2[i])) {
-            double v1 = std::stod(tokens1[i]);
-            double v2 = std::stod(tokens2[i]);
-            double diff = percentageDifference(v1, v2);
-            if (std::abs(diff) > tol_) {
-                any_error = true;
-                if (std::abs(diff) > max_diff_this_line) max_diff_this_line = std::abs(diff);
-                std::string t1 = tokens1[i];
-                std::string t2 = tokens2[i];
-                if (color_diff_digits_) {
-                    colorizeDiffDigits(t1, t2);
-                } else {
-                    printRed(t1);
-                    printRed(t2);
+        any_error = true;
+        if (std::abs(diff) > result.max_error) result.max_error = std::abs(diff);
+        column_errors[i] = diff;
+        is_diff[i] = true;
+        if (column_stats_) recordColumnStats(column_offset_ + i, diff);
+    };
+    if (profiler_) {
+        // Parse everything first, then compare, so that each phase can be timed
+        profiler_->addTokens(tokens1.size() + tokens2.size());
+        std::vector<double>& values1 = scratch_.values1;
+        std::vector<double>& values2 = scratch_.values2;
+        std::vector<bool>& numeric = scratch_.numeric;
+        values1.assign(n, 0.0);
+        values2.assign(n, 0.0);
+        numeric.assign(n, false);
+        {
+            Profiler::Scope scope(profiler_, Profiler::kParse);
+            size_t parses = 0, fast_path = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (tokens1[i] == tokens2[i]) {
+                    ++fast_path;
+                    continue;
                 }
-                output1.push_back(t1);
-                output2.push_back(t2);
-                is_diff.push_back(true);
-                std::ostringstream oss;
-                oss << std::setw(static_cast<int>(col_widths[i])) << std::setfill(' ') << std::right << diff << "%";
-                errors.push_back(oss.str());
-            } else {
-                output1.push_back(tokens1[i]);
-                output2.push_back(tokens2[i]);
-                is_diff.push_back(false);
-                errors.push_back(std::string(col_widths[i], ' '));
+                if (!parsed) ++parses;
+                if (!value1(i, values1[i])) continue;
+                if (!parsed) ++parses;
+                numeric[i] = value2(i, values2[i]);
             }
-        } else {
-            // Non-numeric tokens are just copied
-            output1.push_back(tokens1[i]);
-            output2.push_back(tokens2[i]);
-            is_diff.push_back(false);
-            errors.push_back(std::string(col_widths[i], ' '));
+            profiler_->addParses(parses);
+            profiler_->addFastPathCells(fast_path);
+            fast_path_cells_ += fast_path;
+        }
+        Profiler::Scope scope(profiler_, Profiler::kCompare);
+        for (size_t i = 0; i < n; ++i) {
+            if (numeric[i]) compareColumn(i, values1[i], values2[i]);
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            // Identical text is an identical value (or the same non-numeric token) under
+            // every policy, so only cells whose bytes differ are parsed
+            if (tokens1[i] == tokens2[i]) {
+                ++fast_path_cells_;
+                continue;
+            }
+            // Compare only if both tokens are numeric
+            double v1 = 0.0, v2 = 0.0;
+            if (!value1(i, v1) || !value2(i, v2)) continue;
+            compareColumn(i, v1, v2);
         }
     }
+    result.any_error = result.any_error || any_error;
 
-    if (any_error) {
-        ++diff_lines_;
-        if (max_diff_this_line > max_percentage_error_) max_percentage_error_ = max_diff_this_line;
-    }
-
-    if (only_equal_) {
+    if constexpr (Mode::kSummaryOnly) {
         // Do not print anything for individual lines in only_equal_ mode
         return;
-    }
+    } else {
+        if constexpr (!Mode::kSideBySide || Mode::kSuppressCommon) {
+            // Only lines with differences are printed
+            if (!any_error) return;
+        }
 
-    // Print in diff style
-    if (side_by_side_) {
-        if (suppress_common_lines_) {
-            if (any_error) {
-                // Print tokens side by side, column by column
-                printSideBySideTokens(output1, output2, col_widths);
+        Profiler::Scope scope(profiler_, Profiler::kPrint);
+        if constexpr (Mode::kRecords) {
+            // One record per differing cell, numbered like the input (1-based)
+            size_t line = lines_compared_ + 1;
+            for (size_t i = 0; i < n; ++i) {
+                if (!is_diff[i]) continue;
+                size_t k = column_offset_ + i;
+                size_t column = selected_columns_.empty() ? k + 1 : selected_columns_[k];
+                double v1 = 0.0, v2 = 0.0;
+                value1(i, v1);
+                value2(i, v2);
+                record_writer_->cell(line, column, v1, v2, column_errors[i]);
             }
-            // else: do not print common lines
-        } else {
-            printSideBySideTokens(output1, output2, col_widths);
+            return;
         }
-    } else {
-        // Join tokens for output
-        auto join = [](const std::vector<std::string>& v) {
-            std::string out;
-            for (size_t i = 0; i < v.size(); ++i) {
-                if (i > 0) out += " ";
-                out += v[i];
+        // Calculate column widths for pretty output
+        std::vector<size_t>& col_widths = scratch_.col_widths;
+        calc_col_widths(tokens1, tokens2, col_widths);
+        // Build both lines (and the error line) in one pass; highlights are kept apart
+        // from the text, so widths are known without rescanning
+        StyledLine& line1 = scratch_.line1;
+        StyledLine& line2 = scratch_.line2;
+        std::string& errors = scratch_.errors;
+        line1.clear();
+        line2.clear();
+        errors.clear();
+        for (size_t i = 0; i < n; ++i) {
+            if (i > 0) {
+                line1.append(" ");
+                line2.append(" ");
+                if constexpr (!Mode::kSideBySide) errors += ' ';
+            }
+            if (!is_diff[i]) {
+                // Non-numeric and equal tokens are just copied
+                line1.append(tokens1[i]);
+                line2.append(tokens2[i]);
+                if constexpr (!Mode::kSideBySide) errors.append(col_widths[i], ' ');
+            } else {
+                if constexpr (Mode::kColorDigits) {
+                    appendDiffDigits(tokens1[i], tokens2[i], line1, line2);
+                } else {
+                    line1.append(tokens1[i], true);
+                    line2.append(tokens2[i], true);
+                }
+                if constexpr (!Mode::kSideBySide) {
+                    // Right-aligned in the column, formatted like an ostream (%g, 6 digits)
+                    char buffer[32];
+                    auto res = std::to_chars(buffer, buffer + sizeof(buffer), column_errors[i],
+                                             std::chars_format::general, 6);
+                    size_t length = static_cast<size_t>(res.ptr - buffer);
+                    if (length < col_widths[i]) errors.append(col_widths[i] - length, ' ');
+                    errors.append(buffer, length);
+                    errors += '%';
+                }
             }
-            return out;
-        };
-        toPrint1 = join(output1);
-        toPrint2 = join(output2);
-        toPrintErrors = join(errors);
-        printDiff(toPrint1, toPrint2, toPrintErrors);
-    }
-}
-
-// New helper: print tokens side by side, column by column, with color and padding
-void NumericDiff::printSideBySideTokens(const std::vector<std::string>& tokens1, const std::vector<std::string>& tokens2, const std::vector<size_t>& col_widths) const {
-    // Print tokens side by side, aligning columns. Never truncate or cut numeric values: if a value is longer than the max column width, the column expands to fit the value. The max column width only limits padding/alignment, not the content of the numbers. ANSI color codes are ignored for width calculations.
-    std::ostringstream oss1, oss2;
-    size_t ncols = std::max(tokens1.size(), tokens2.size());
-    for (size_t i = 0; i < ncols; ++i) {
-        std::string t1 = (i < tokens1.size()) ? tokens1[i] : "";
-        std::string t2 = (i < tokens2.size()) ? tokens2[i] : "";
-        std::string t1_stripped = stripAnsi(t1);
-        std::string t2_stripped = stripAnsi(t2);
-        // Determine the width for this column: max of user col_width and actual token width
-        size_t colw = (i < col_widths.size()) ? col_widths[i] : static_cast<size_t>(line_length_);
-        colw = std::max({colw, t1_stripped.size(), t2_stripped.size()});
-        // Print first token, padded
-        oss1 << t1;
-        if (t1_stripped.size() < colw)
-            oss1 << std::string(colw - t1_stripped.size(), ' ');
-        // Print second token, padded
-        oss2 << t2;
-        if (t2_stripped.size() < colw)
-            oss2 << std::string(colw - t2_stripped.size(), ' ');
-        if (i + 1 < ncols) {
-            oss1 << " ";
-            oss2 << " ";
-        }
-    }
-    std::string l1 = oss1.str();
-    std::string l2 = oss2.str();
-    // Decide separator: if either line has red color, use |, else use spaces
-    bool has_red = (l1.find("\033[31m") != std::string::npos) || (l2.find("\033[31m") != std::string::npos);
-    const char* sep = has_red ? "   |   " : "       ";
-    l1 = extractVisiblePrefix(l1, static_cast<size_t>(line_length_));
-    l2 = extractVisiblePrefix(l2, static_cast<size_t>(line_length_));
-    std::cout << l1 << sep << l2 << "\n";
+            if constexpr (Mode::kSideBySide) {
+                // Never cut a value: the column is as wide as its longer token
+                line1.pad(col_widths[i] - tokens1[i].size());
+                line2.pad(col_widths[i] - tokens2[i].size());
+            }
+        }
+
+        if constexpr (Mode::kSideBySide) {
+            printSideBySide(line1, line2);
+        } else {
+            printDiff(line1, line2, errors);
+        }
+    }
+}
+
+// Print two lines side by side, each cut to line_length_ visible characters. The
+// separator marks lines with differences, whether or not colors are written.
+void NumericDiff::printSideBySide(const StyledLine& line1, const StyledLine& line2) const {
+    const char* sep = (line1.highlighted() || line2.highlighted()) ? "   |   " : "       ";
+    line1.write(*out_, color_, static_cast<size_t>(line_length_));
+    *out_ << sep;
+    line2.write(*out_, color_, static_cast<size_t>(line_length_));
+    *out_ << "\n";
 }
 
 // Calculate the percentage difference between two values
@@ -323,95 +1107,34 @@ double NumericDiff::percentageDifference(double value1, double value2) const {
     return percentage_diff; // Return the percentage difference
 }
 
-// Helper to strip ANSI escape codes (color codes) from a string
-std::string NumericDiff::stripAnsi(const std::string& input) const {
-    std::string result;
-    bool in_escape = false;
-    for (size_t i = 0; i < input.size(); ++i) {
-        if (!in_escape) {
-            if (input[i] == '\033' && i + 1 < input.size() && input[i + 1] == '[') {
-                in_escape = true;
-            } else {
-                result += input[i];
-            }
-        } else {
-            // End of ANSI escape sequence is marked by 'm'
-            if (input[i] == 'm') {
-                in_escape = false;
-            }
-        }
-    }
-    return result;
-}
-
-// Extract the first n visible (non-ANSI) characters from a string, preserving formatting codes
-std::string NumericDiff::extractVisiblePrefix(const std::string& input, size_t n) const {
-    std::string result;
-    size_t visible_count = 0;
-    bool in_escape = false;
-    for (size_t i = 0; i < input.size(); ++i) {
-        if (!in_escape) {
-            if (input[i] == '\033' && i + 1 < input.size() && input[i + 1] == '[') {
-                in_escape = true;
-                result += input[i];
-            } else {
-                if (visible_count < n) {
-                    result += input[i];
-                    ++visible_count;
-                } else {
-                    break;
-                }
-            }
-        } else {
-            result += input[i];
-            if (input[i] == 'm') {
-                in_escape = false;
-            }
-        }
-    }
-    // Ensure the result ends with a reset code if it was in an escape sequence
-    ensureAnsiReset(result);
-    return result;
-}
-
 // Print differences in a diff-like format
-void NumericDiff::printDiff(const std::string& output1, const std::string& output2, const std::string& errors) const {
-    // Only print lines that contain red marks (i.e., differences)
-    bool has_red1 = output1.find("\033[31m") != std::string::npos;
-    bool has_red2 = output2.find("\033[31m") != std::string::npos;
-    if (has_red1 || has_red2) {
-        std::cout << '\n';
-        std::cout << "< " << output1 << "\n";
-        std::cout << "> " << output2 << "\n";
-        std::cout << ">>" << errors << "\n";
+void NumericDiff::printDiff(const StyledLine& line1, const StyledLine& line2, const std::string& errors) const {
+    // Only print lines that contain highlights (i.e., differences)
+    if (line1.highlighted() || line2.highlighted()) {
+        *out_ << '\n';
+        *out_ << "< ";
+        line1.write(*out_, color_);
+        *out_ << "\n";
+        *out_ << "> ";
+        line2.write(*out_, color_);
+        *out_ << "\n";
+        *out_ << ">>" << errors << "\n";
     }
 }
 
-// Ensure the string ends with the ANSI reset code if the last color set is not reset
-void NumericDiff::ensureAnsiReset(std::string& str) const {
-    // Only handle red for now: \033[31m ... \033[0m
-    // If the string contains a red start but does not end with reset, add reset
-    const std::string red_start = "\033[31m";
-    const std::string reset = "\033[0m";
-    size_t last_red = str.rfind(red_start);
-    size_t last_reset = str.rfind(reset);
-    if (last_red != std::string::npos && (last_reset == std::string::npos || last_reset < last_red)) {
-        str += reset;
-    }
-}
-
-// Colorize only the digits that differ between s1 and s2 (ANSI red: \033[31m ... \033[0m)
-void NumericDiff::colorizeDiffDigits(std::string& s1, std::string& s2) const {
+// Append two numeric tokens, highlighting only the digits that differ: the mantissa from
+// the first differing character on, and the exponent if it differs or if the mantissas do
+void NumericDiff::appendDiffDigits(std::string_view s1, std::string_view s2, StyledLine& line1,
+                                   StyledLine& line2) const {
     // If either string contains 'e' or 'E', split into mantissa and exponent
-    auto split_exp = [](const std::string& s) -> std::pair<std::string, std::string> {
+    auto split_exp = [](std::string_view s) -> std::pair<std::string_view, std::string_view> {
         size_t epos = s.find_first_of("eE");
-        if (epos == std::string::npos) return {s, ""};
+        if (epos == std::string_view::npos) return {s, {}};
         return {s.substr(0, epos), s.substr(epos)};
     };
     auto [mant1, exp1] = split_exp(s1);
     auto [mant2, exp2] = split_exp(s2);
 
-    std::string out1, out2;
     size_t n = std::min(mant1.size(), mant2.size());
     size_t diff_start = n;
     // Find first differing digit in mantissa
@@ -421,34 +1144,14 @@ void NumericDiff::colorizeDiffDigits(std::string& s1, std::string& s2) const {
             break;
         }
     }
-    // If mantissas are different length, diff starts at min size
-    if (mant1.size() != mant2.size()) {
-        diff_start = std::min(diff_start, n);
-    }
-    // Build colored mantissas: everything after diff_start is red
-    if (diff_start < mant1.size()) {
-        out1 = mant1.substr(0, diff_start) + "\033[31m" + mant1.substr(diff_start) + "\033[0m";
-    } else {
-        out1 = mant1;
-    }
-    if (diff_start < mant2.size()) {
-        out2 = mant2.substr(0, diff_start) + "\033[31m" + mant2.substr(diff_start) + "\033[0m";
-    } else {
-        out2 = mant2;
-    }
-    // If any difference in mantissa, color all exponent (even if equal)
-    if (!exp1.empty() || !exp2.empty()) {
-        if (diff_start < n || mant1.size() != mant2.size()) {
-            if (!exp1.empty()) out1 += "\033[31m" + exp1 + "\033[0m";
-            if (!exp2.empty()) out2 += "\033[31m" + exp2 + "\033[0m";
-        } else if (exp1 == exp2) {
-            out1 += exp1;
-            out2 += exp2;
-        } else {
-            if (!exp1.empty()) out1 += "\033[31m" + exp1 + "\033[0m";
-            if (!exp2.empty()) out2 += "\033[31m" + exp2 + "\033[0m";
-        }
-    }
-    s1 = out1;
-    s2 = out2;
-}
\ No newline at end of file
+    // Mantissas: everything from diff_start on is highlighted
+    line1.append(mant1.substr(0, diff_start));
+    if (diff_start < mant1.size()) line1.append(mant1.substr(diff_start), true);
+    line2.append(mant2.substr(0, diff_start));
+    if (diff_start < mant2.size()) line2.append(mant2.substr(diff_start), true);
+    // If any difference in mantissa, highlight all exponent (even if equal)
+    bool mantissas_differ = diff_start < n || mant1.size() != mant2.size();
+    bool highlight_exp = mantissas_differ || exp1 != exp2;
+    if (!exp1.empty()) line1.append(exp1, highlight_exp);
+    if (!exp2.empty()) line2.append(exp2, highlight_exp);
+}
@@ -1,8 +1,10 @@
 // NumericDiffOption.cpp
 #include "diff-numerics/NumericDiffOption.h"
+#include "diff-numerics/ColumnPolicy.h"
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
+#include <cerrno>
 
 // Define static member
 const std::string NumericDiffOption::usage =
@@ -17,7 +19,27 @@ const std::string NumericDiffOption::usage =
     "  -s,  --report-identical-files   Only show equal lines (default: off)\n"
     "  -q,  --quiet                    Suppress output (default: off)\n"
     "  -d,  --color-different-digits   Color differing digits (default: off)\n"
+    "       --color <when>             Color differences: auto, always or never (default: auto, on a terminal)\n"
     "  -C,  --columns <list>           Compare only specified columns (comma-separated, 1-based, default: all)\n"
+    "       --column-policy <spec>     Per-column rule <columns>:<mode>[:<tol>[:<threshold>]], mode rel, abs, ulp or exact\n"
+    "       --policy-file <file>       Read per-column rules from a file, one per line\n"
+    "       --block-index <file>       Skip blocks verified equal in a previous run (persistent index)\n"
+    "       --block-size <n>           Lines per fingerprinted block for --block-index (default: 64)\n"
+    "       --wide-rows <n>            Stream very long lines in segments of n columns (bounded memory)\n"
+    "  -b,  --blocks                   Compare blank-line-separated blocks in parallel, with per-block summaries\n"
+    "  -j,  --jobs <n>                 Worker threads for --blocks (default: one per hardware thread)\n"
+    "       --input-format <f>[,<f2>]  Input format: auto, text, npy or raw (default: auto, by extension)\n"
+    "       --raw-columns <n>          Number of columns of raw binary double arrays (default: 1)\n"
+    "       --serve <socket>           Run as a comparison server on a Unix socket (uses -j workers)\n"
+    "       --cache-size <MiB>         Memory budget of the server's file cache (default: 256)\n"
+    "       --connect <socket>         Run the comparison on a server (default: $DIFF_NUMERICS_SERVER)\n"
+    "       --format <f>               Output format: text, jsonl or csv (one record per differing cell)\n"
+    "       --max-output-bytes <n>     Stop writing jsonl/csv cell records after n bytes (default: no limit)\n"
+    "       --max-records <n>          Stop writing jsonl/csv cell records after n records (default: no limit)\n"
+    "       --profile                  Report phase timings, throughput and memory on stderr\n"
+    "       --profile-json             Same as --profile, as a single JSON object\n"
+    "       --perf-counters            Add hardware counters to the profile, when permitted\n"
+    "       --progress                 Report bytes, throughput, differing lines and ETA on stderr\n"
     "  -v,  --version                  Show program version and exit\n"
     "  -h,  --help                     Show this help message\n";
 
@@ -30,13 +52,14 @@ void NumericDiffOption::print_usage() {
     std::cout << usage << std::endl;
 }
 
-bool NumericDiffOption::parse_columns(const std::string& col_arg, std::set<size_t>& columns_to_compare, const std::string& usage) {
+bool NumericDiffOption::parse_columns(const std::string& col_arg, std::set<size_t>& columns_to_compare,
+                                      const std::string& usage, std::ostream& err) {
     std::stringstream ss(col_arg);
     std::string col;
     while (std::getline(ss, col, ',')) {
         size_t col_num = std::stoul(col);
         if (col_num < 1) {
-            std::cerr << "Error: Column numbers must be at least 1 (got " << col_num << ").\n" << usage;
+            err << "Error: Column numbers must be at least 1 (got " << col_num << ").\n" << usage;
             return false;
         }
         columns_to_compare.insert(col_num);
@@ -44,7 +67,18 @@ bool NumericDiffOption::parse_columns(const std::string& col_arg, std::set<size_
     return true;
 }
 
-bool NumericDiffOption::parse_args(int argc, char* argv[]) {
+// Parse a non-negative decimal count: digits only (no sign or blanks), no overflow
+bool NumericDiffOption::parse_count(const std::string& text, size_t& value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+    if (errno == ERANGE || end != text.c_str() + text.size() || parsed > SIZE_MAX) return false;
+    value = static_cast<size_t>(parsed);
+    return true;
+}
+
+bool NumericDiffOption::parse_args(int argc, char* argv[], std::ostream& err) {
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "-v" || arg == "--version") {
@@ -59,28 +93,28 @@ bool NumericDiffOption::parse_args(int argc, char* argv[]) {
             if (i + 1 < argc) {
                 tolerance = std::atof(argv[++i]);
             } else {
-                std::cerr << "Error: Missing value for " << arg << " option.\n" << usage;
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
                 return false;
             }
         } else if (arg == "-threshold" || arg == "-T" || arg == "--threshold") {
             if (i + 1 < argc) {
                 threshold = std::atof(argv[++i]);
             } else {
-                std::cerr << "Error: Missing value for " << arg << " option.\n" << usage;
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
                 return false;
             }
         } else if ((arg == "--comment" || arg == "-c" || arg == "--comment-string")) {
             if (i + 1 < argc) {
                 comment_char = argv[++i];
             } else {
-                std::cerr << "Error: Missing value for " << arg << " option.\n" << usage;
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
                 return false;
             }
         } else if (arg == "-w" || arg == "--single-column-width") {
             if (i + 1 < argc) {
                 line_length = std::atoi(argv[++i]);
             } else {
-                std::cerr << "Error: Missing value for " << arg << " option.\n" << usage;
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
                 return false;
             }
         } else if (arg == "--only-equal" || arg == "-s") {
@@ -91,55 +125,246 @@ bool NumericDiffOption::parse_args(int argc, char* argv[]) {
             color_diff_digits = true;
         } else if (arg == "-C" || arg == "--columns") {
             if (i + 1 < argc) {
-                if (!parse_columns(argv[++i], columns_to_compare, usage)) return false;
+                if (!parse_columns(argv[++i], columns_to_compare, usage, err)) return false;
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--block-index") {
+            if (i + 1 < argc) {
+                block_index = argv[++i];
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--block-size") {
+            if (i + 1 < argc) {
+                if (!parse_count(argv[++i], block_size)) {
+                    err << "Error: Invalid block size '" << argv[i] << "'.\n" << usage;
+                    return false;
+                }
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--wide-rows") {
+            if (i + 1 < argc) {
+                // 0 is the default (disabled), not a segment width
+                if (!parse_count(argv[++i], wide_row_columns) || wide_row_columns == 0) {
+                    err << "Error: Invalid number of wide-row columns '" << argv[i] << "'.\n" << usage;
+                    return false;
+                }
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "-b" || arg == "--blocks") {
+            blocks = true;
+        } else if (arg == "-j" || arg == "--jobs") {
+            if (i + 1 < argc) {
+                if (!parse_count(argv[++i], jobs)) {
+                    err << "Error: Invalid number of jobs '" << argv[i] << "'.\n" << usage;
+                    return false;
+                }
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--input-format") {
+            if (i + 1 < argc) {
+                std::string formats = argv[++i];
+                size_t comma = formats.find(',');
+                input_format1 = formats.substr(0, comma);
+                input_format2 = (comma == std::string::npos) ? input_format1 : formats.substr(comma + 1);
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--raw-columns") {
+            if (i + 1 < argc) {
+                if (!parse_count(argv[++i], raw_columns)) {
+                    err << "Error: Invalid raw column count '" << argv[i] << "'.\n" << usage;
+                    return false;
+                }
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--serve" || arg == "--connect") {
+            if (i + 1 < argc) {
+                (arg == "--serve" ? serve_socket : connect_socket) = argv[++i];
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--cache-size") {
+            if (i + 1 < argc) {
+                if (!parse_count(argv[++i], cache_mb)) {
+                    err << "Error: Invalid cache size '" << argv[i] << "'.\n" << usage;
+                    return false;
+                }
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--color") {
+            if (i + 1 < argc) {
+                color = argv[++i];
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--column-policy" || arg == "--policy-file") {
+            if (i + 1 < argc) {
+                if (arg == "--policy-file") {
+                    policy_file = argv[++i];
+                } else {
+                    column_policies.push_back(argv[++i]);
+                }
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--format") {
+            if (i + 1 < argc) {
+                output_format = argv[++i];
+            } else {
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
+                return false;
+            }
+        } else if (arg == "--max-output-bytes" || arg == "--max-records") {
+            if (i + 1 < argc) {
+                // A typo must not silently become 0, which means no cap
+                size_t cap = 0;
+                if (!parse_count(argv[++i], cap)) {
+                    err << "Error: Invalid value '" << argv[i] << "' for " << arg << ".\n" << usage;
+                    return false;
+                }
+                (arg == "--max-records" ? max_records : max_output_bytes) = cap;
             } else {
-                std::cerr << "Error: Missing value for " << arg << " option.\n" << usage;
+                err << "Error: Missing value for " << arg << " option.\n" << usage;
                 return false;
             }
+        } else if (arg == "--progress") {
+            progress = true;
+        } else if (arg == "--profile") {
+            profile = "text";
+        } else if (arg == "--profile-json") {
+            profile = "json";
+        } else if (arg == "--perf-counters") {
+            perf_counters = true;
+            if (profile.empty()) profile = "text";
         } else if (file1.empty()) {
             file1 = arg;
         } else if (file2.empty()) {
             file2 = arg;
         } else {
-            std::cerr << "Unknown or extra argument: " << arg << "\n" << usage;
+            err << "Unknown or extra argument: " << arg << "\n" << usage;
             return false;
         }
     }
     return true;
 }
 
-bool NumericDiffOption::validate_options() const {
+bool NumericDiffOption::validate_options(std::ostream& err) const {
+    if (!serve_socket.empty()) {
+        // A server takes its files from the clients
+        if (!file1.empty()) {
+            err << "Error: --serve does not take input files.\n" << usage;
+            return false;
+        }
+        const size_t max_cache_mb = SIZE_MAX >> 20;  // The budget in bytes must fit a size_t
+        if (cache_mb > max_cache_mb) {
+            err << "Error: Cache size must be at most " << max_cache_mb << " MiB.\n" << usage;
+            return false;
+        }
+        return true;
+    }
     if (file1.empty() || file2.empty()) {
-        std::cerr << "Error: Two input files must be specified.\n" << usage;
+        err << "Error: Two input files must be specified.\n" << usage;
         return false;
     }
     if (file1 == file2) {
-        std::cerr << "Error: The two input files must be different.\n" << usage;
+        err << "Error: The two input files must be different.\n" << usage;
         return false;
     }
     const int min_col_width = 10, max_col_width = 200;
     const double min_tol = 1e-15, max_tol = 1e+3;
     const double min_threshold = 0.0, max_threshold = 1e+3;
+    const size_t max_block_size = 1 << 20;  // Lines per block, held in memory for each file
+    const size_t max_jobs = 1024;
+    const size_t max_wide_row_columns = 1 << 20;  // Columns per segment, held in memory for each file
+    const size_t max_raw_columns = size_t(1) << 30;  // Rows of 8 GiB
     if (line_length < min_col_width || line_length > max_col_width) {
-        std::cerr << "Error: Column width (" << line_length << ") must be between " << min_col_width << " and " << max_col_width << ".\n" << usage;
+        err << "Error: Column width (" << line_length << ") must be between " << min_col_width << " and " << max_col_width << ".\n" << usage;
         return false;
     }
     if (tolerance < min_tol || tolerance > max_tol) {
-        std::cerr << "Error: Tolerance (" << tolerance << ") must be between " << min_tol << " and " << max_tol << ".\n" << usage;
+        err << "Error: Tolerance (" << tolerance << ") must be between " << min_tol << " and " << max_tol << ".\n" << usage;
         return false;
     }
     if (threshold < min_threshold || threshold > max_threshold) {
-        std::cerr << "Error: Threshold (" << threshold << ") must be between " << min_threshold << " and " << max_threshold << ".\n" << usage;
+        err << "Error: Threshold (" << threshold << ") must be between " << min_threshold << " and " << max_threshold << ".\n" << usage;
+        return false;
+    }
+    if (block_size < 1 || block_size > max_block_size) {
+        err << "Error: Block size must be between 1 and " << max_block_size << ".\n" << usage;
+        return false;
+    }
+    if (jobs > max_jobs) {
+        err << "Error: Number of jobs must be at most " << max_jobs << ".\n" << usage;
+        return false;
+    }
+    if (wide_row_columns > max_wide_row_columns) {
+        err << "Error: Wide-row segments must have at most " << max_wide_row_columns << " columns.\n" << usage;
+        return false;
+    }
+    if (wide_row_columns > 0 && !block_index.empty()) {
+        err << "Error: --wide-rows cannot be combined with --block-index.\n" << usage;
+        return false;
+    }
+    for (const std::string& format : {input_format1, input_format2}) {
+        if (format != "auto" && format != "text" && format != "npy" && format != "raw") {
+            err << "Error: Unknown input format '" << format << "' (expected auto, text, npy or raw).\n" << usage;
+            return false;
+        }
+    }
+    if (color != "auto" && color != "always" && color != "never") {
+        err << "Error: Unknown color mode '" << color << "' (expected auto, always or never).\n" << usage;
+        return false;
+    }
+    for (const auto& spec : column_policies) {
+        ColumnPolicyRule rule;
+        std::string error;
+        if (!ColumnPolicyRule::parse(spec, rule, error)) {
+            err << "Error: " << error << ".\n" << usage;
+            return false;
+        }
+    }
+    if (output_format != "text" && output_format != "jsonl" && output_format != "csv") {
+        err << "Error: Unknown output format '" << output_format << "' (expected text, jsonl or csv).\n" << usage;
+        return false;
+    }
+    if (output_format == "text" && (max_output_bytes > 0 || max_records > 0)) {
+        err << "Error: --max-output-bytes and --max-records require --format jsonl or csv.\n" << usage;
+        return false;
+    }
+    if (raw_columns < 1 || raw_columns > max_raw_columns) {
+        err << "Error: Raw column count must be between 1 and " << max_raw_columns << ".\n" << usage;
+        return false;
+    }
+    if (blocks && (wide_row_columns > 0 || !block_index.empty())) {
+        err << "Error: --blocks cannot be combined with --wide-rows or --block-index.\n" << usage;
         return false;
     }
     return true;
 }
 
 // Implement parse and validate as wrappers for parse_args and validate_options
-bool NumericDiffOption::parse(int argc, char* argv[]) {
-    return parse_args(argc, argv);
+bool NumericDiffOption::parse(int argc, char* argv[], std::ostream& err) {
+    return parse_args(argc, argv, err);
 }
 
-bool NumericDiffOption::validate() const {
-    return validate_options();
+bool NumericDiffOption::validate(std::ostream& err) const {
+    return validate_options(err);
 }
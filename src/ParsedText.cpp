@@ -0,0 +1,50 @@
+// ParsedText.cpp
+// -------------------------------------------------------------
+// This file implements ParsedText: splitting data lines into fields and
+// parsing their values, once per cached file.
+// -------------------------------------------------------------
+
+#include "diff-numerics/ParsedText.h"
+#include "diff-numerics/FieldReader.h"
+#include <cstdlib>
+
+size_t ParsedText::bytes() const {
+    return text.capacity() + (line_starts.capacity() + first_field.capacity()) * sizeof(size_t) +
+           fields.capacity() * sizeof(Field);
+}
+
+// Fields are split at the separators of FieldReader, and a field is numeric if strtod
+// consumes all of it, as in NumericDiff::parseNumber()
+std::shared_ptr<const ParsedText> ParsedText::parse(std::string text) {
+    auto parsed = std::make_shared<ParsedText>();
+    parsed->text = std::move(text);
+    const std::string& data = parsed->text;
+    const size_t size = data.size();
+    size_t pos = 0;
+    while (pos < size) {
+        parsed->line_starts.push_back(pos);
+        parsed->first_field.push_back(parsed->fields.size());
+        while (true) {
+            while (pos < size && data[pos] != '\n' && FieldReader::isSpace(data[pos])) ++pos;
+            if (pos == size || data[pos] == '\n') break;
+            size_t start = pos;
+            while (pos < size && !FieldReader::isSpace(data[pos])) ++pos;
+            if (pos - start > UINT32_MAX) return nullptr;
+            Field field;
+            field.offset = start;
+            field.length = static_cast<uint32_t>(pos - start);
+            // The field ends at whitespace, so strtod never reads past it
+            char* end = nullptr;
+            field.value = std::strtod(data.c_str() + start, &end);
+            field.numeric = end != data.c_str() + start && end == data.c_str() + pos;
+            parsed->fields.push_back(field);
+        }
+        ++pos;  // Past the '\n'
+    }
+    parsed->line_starts.push_back(size);
+    parsed->first_field.push_back(parsed->fields.size());
+    parsed->line_starts.shrink_to_fit();
+    parsed->first_field.shrink_to_fit();
+    parsed->fields.shrink_to_fit();
+    return parsed;
+}
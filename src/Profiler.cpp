@@ -0,0 +1,204 @@
+// Profiler.cpp
+// -------------------------------------------------------------
+// This file implements the Profiler class: phase timers, process-wide
+// resource sampling, optional perf_event hardware counters, and the text
+// and JSON reports.
+// -------------------------------------------------------------
+
+#include "diff-numerics/Profiler.h"
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <ostream>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+uint64_t (*g_allocation_counter)() = nullptr;
+
+int64_t clockNs(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+double seconds(int64_t ns) { return static_cast<double>(ns) * 1e-9; }
+}  // namespace
+
+// Scope: sample the clocks on entry...
+void Profiler::Scope::begin() {
+    thread_local uint32_t scopes[kPhaseCount] = {};
+    uint32_t count = scopes[phase_]++;
+    if (count < kCpuSampleInterval || count % kCpuSampleInterval == 0) {
+        cpu_start_ns_ = clockNs(CLOCK_THREAD_CPUTIME_ID);
+    }
+    wall_start_ = std::chrono::steady_clock::now();
+}
+
+// ...and charge the elapsed time to the phase on exit
+void Profiler::Scope::end() {
+    int64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - wall_start_).count();
+    profiler_->wall_ns_[phase_].fetch_add(wall, std::memory_order_relaxed);
+    if (cpu_start_ns_ < 0) return;
+    profiler_->sampled_wall_ns_[phase_].fetch_add(wall, std::memory_order_relaxed);
+    int64_t cpu = clockNs(CLOCK_THREAD_CPUTIME_ID) - cpu_start_ns_ - profiler_->cpu_clock_overhead_ns_;
+    profiler_->sampled_cpu_ns_[phase_].fetch_add(cpu > 0 ? cpu : 0, std::memory_order_relaxed);
+}
+
+// Constructor: measure what an empty sampled scope costs, so it can be taken out of the
+// samples. Counters are opened right away so that start() only has to enable them.
+Profiler::Profiler(bool hardware_counters) : hardware_counters_(hardware_counters) {
+    int64_t overhead = -1;
+    for (int i = 0; i < 64; ++i) {
+        int64_t cpu_start = clockNs(CLOCK_THREAD_CPUTIME_ID);
+        auto wall_start = std::chrono::steady_clock::now();
+        auto wall_end = std::chrono::steady_clock::now();
+        int64_t cpu = clockNs(CLOCK_THREAD_CPUTIME_ID) - cpu_start -
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(wall_end - wall_start).count();
+        if (overhead < 0 || cpu < overhead) overhead = cpu;
+    }
+    cpu_clock_overhead_ns_ = overhead > 0 ? overhead : 0;
+    if (hardware_counters_) openHardwareCounters();
+}
+
+Profiler::~Profiler() {
+    for (auto& counter : counters_) close(counter.fd);
+}
+
+// Count user-space events of this process and of the threads it creates. Counters
+// that cannot be opened (no PMU, perf_event_paranoid, containers) are skipped.
+void Profiler::openHardwareCounters() {
+    const struct {
+        const char* name;
+        uint64_t config;
+    } events[] = {{"cycles", PERF_COUNT_HW_CPU_CYCLES},
+                  {"instructions", PERF_COUNT_HW_INSTRUCTIONS},
+                  {"cache_misses", PERF_COUNT_HW_CACHE_MISSES},
+                  {"branch_misses", PERF_COUNT_HW_BRANCH_MISSES}};
+    for (const auto& event : events) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = event.config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd >= 0) counters_.push_back({event.name, fd, 0});
+    }
+}
+
+// Sample process-wide figures at the beginning of the run
+void Profiler::start() {
+    run_start_ = std::chrono::steady_clock::now();
+    process_cpu_start_ns_ = clockNs(CLOCK_PROCESS_CPUTIME_ID);
+    allocations_start_ = g_allocation_counter ? g_allocation_counter() : 0;
+    for (auto& counter : counters_) {
+        ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+// Sample them again at the end
+void Profiler::stop() {
+    for (auto& counter : counters_) {
+        ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter.fd, &counter.value, sizeof(counter.value)) != sizeof(counter.value)) {
+            counter.value = 0;
+        }
+    }
+    run_stop_ = std::chrono::steady_clock::now();
+    process_cpu_ns_ = clockNs(CLOCK_PROCESS_CPUTIME_ID) - process_cpu_start_ns_;
+    allocations_ = g_allocation_counter ? g_allocation_counter() - allocations_start_ : 0;
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) peak_rss_kb_ = usage.ru_maxrss;
+}
+
+// Report: per-phase table, counters and rates over the total wall time
+void Profiler::report(std::ostream& os, bool json) const {
+    int64_t total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(run_stop_ - run_start_).count();
+    double total = seconds(total_ns);
+    double rate_base = total > 0.0 ? total : 1e-9;
+    double mb_per_s = static_cast<double>(bytes()) / 1e6 / rate_base;
+    double lines_per_s = static_cast<double>(lines()) / rate_base;
+    std::ios_base::fmtflags flags = os.flags();
+
+    if (json) {
+        os << "{\"wall_s\": " << total << ", \"cpu_s\": " << seconds(process_cpu_ns_) << ", \"phases\": {";
+        for (int p = 0; p < kPhaseCount; ++p) {
+            os << (p ? ", " : "") << "\"" << phaseName(static_cast<Phase>(p)) << "\": {\"wall_s\": "
+               << seconds(wall_ns_[p].load()) << ", \"cpu_s\": " << phaseCpuSeconds(p) << "}";
+        }
+        os << "}, \"bytes\": " << bytes() << ", \"lines\": " << lines() << ", \"tokens\": " << tokens()
+           << ", \"parses\": " << parses() << ", \"fast_path_cells\": " << fastPathCells()
+           << ", \"mb_per_s\": " << mb_per_s
+           << ", \"lines_per_s\": " << lines_per_s << ", \"heap_allocations\": ";
+        if (g_allocation_counter) {
+            os << allocations_;
+        } else {
+            os << "null";
+        }
+        os << ", \"peak_rss_kb\": " << peak_rss_kb_;
+        if (hardware_counters_) {
+            os << ", \"hardware\": {";
+            for (size_t i = 0; i < counters_.size(); ++i) {
+                os << (i ? ", " : "") << "\"" << counters_[i].name << "\": " << counters_[i].value;
+            }
+            os << "}";
+        }
+        os << "}\n";
+        os.flags(flags);
+        return;
+    }
+
+    os << "Profile (wall " << std::fixed << std::setprecision(6) << total << " s, cpu "
+       << seconds(process_cpu_ns_) << " s)\n";
+    os << "  " << std::left << std::setw(10) << "phase" << std::right << std::setw(14) << "wall [s]"
+       << std::setw(14) << "cpu [s]" << std::setw(9) << "wall %" << "\n";
+    for (int p = 0; p < kPhaseCount; ++p) {
+        double wall = seconds(wall_ns_[p].load());
+        os << "  " << std::left << std::setw(10) << phaseName(static_cast<Phase>(p)) << std::right
+           << std::setw(14) << wall << std::setw(14) << phaseCpuSeconds(p) << std::setw(8)
+           << std::setprecision(1) << (total > 0.0 ? 100.0 * wall / total : 0.0) << "%"
+           << std::setprecision(6) << "\n";
+    }
+    os << std::setprecision(1);
+    os << "  bytes: " << bytes() << " (" << mb_per_s << " MB/s), lines: " << lines() << " ("
+       << std::setprecision(0) << lines_per_s << " lines/s)\n";
+    os << "  tokens: " << tokens() << ", numbers parsed: " << parses()
+       << ", cells equal as text: " << fastPathCells() << "\n";
+    os << "  heap allocations: ";
+    if (g_allocation_counter) {
+        os << allocations_;
+    } else {
+        os << "n/a";
+    }
+    os << ", peak RSS: " << peak_rss_kb_ << " KiB\n";
+    if (hardware_counters_) {
+        os << "  hardware counters:";
+        if (counters_.empty()) os << " unavailable (perf_event_open not permitted)";
+        for (const auto& counter : counters_) os << " " << counter.name << "=" << counter.value;
+        os << "\n";
+    }
+    os.flags(flags);
+}
+
+// CPU time of the sampled scopes, scaled up to the wall time of all scopes
+double Profiler::phaseCpuSeconds(int phase) const {
+    int64_t sampled_wall = sampled_wall_ns_[phase].load();
+    if (sampled_wall <= 0) return seconds(sampled_cpu_ns_[phase].load());
+    return seconds(sampled_cpu_ns_[phase].load()) * seconds(wall_ns_[phase].load()) / seconds(sampled_wall);
+}
+
+void Profiler::setAllocationCounter(uint64_t (*counter)()) { g_allocation_counter = counter; }
+
+const char* Profiler::phaseName(Phase phase) {
+    static const char* const names[kPhaseCount] = {"read", "tokenize", "parse", "compare", "print"};
+    return names[phase];
+}
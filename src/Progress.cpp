@@ -0,0 +1,69 @@
+// Progress.cpp
+// -------------------------------------------------------------
+// This file implements the Progress class: rate limiting and formatting of
+// the --progress status line.
+// -------------------------------------------------------------
+
+#include "diff-numerics/Progress.h"
+#include <cstdio>
+#include <ostream>
+
+Progress::Progress(std::ostream& os, uint64_t total_bytes, bool rewrite, double interval_seconds)
+    : os_(os),
+      total_bytes_(total_bytes),
+      rewrite_(rewrite),
+      interval_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(interval_seconds))),
+      start_(std::chrono::steady_clock::now()),
+      last_report_(start_) {}
+
+// Called every kCheckBytes of input: only report once per interval
+void Progress::update(uint64_t bytes, uint64_t lines, uint64_t diff_lines) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_report_ < interval_) return;
+    last_report_ = now;
+    print(bytes, lines, diff_lines, false);
+}
+
+void Progress::finish(uint64_t bytes, uint64_t lines, uint64_t diff_lines) {
+    print(bytes, lines, diff_lines, true);
+}
+
+// Helper: format and print one report
+void Progress::print(uint64_t bytes, uint64_t lines, uint64_t diff_lines, bool done) {
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    double rate_base = elapsed > 0.0 ? elapsed : 1e-9;
+    double mb = static_cast<double>(bytes) / 1e6;
+    char buffer[256];
+    int n = std::snprintf(buffer, sizeof(buffer), "Progress: %.1f MB", mb);
+    if (total_bytes_ > 0 && !done) {
+        double total = static_cast<double>(total_bytes_);
+        double fraction = static_cast<double>(bytes) / total;
+        n += std::snprintf(buffer + n, sizeof(buffer) - static_cast<size_t>(n), " of %.1f MB (%.0f%%)", total / 1e6,
+                           fraction > 1.0 ? 100.0 : fraction * 100.0);
+    }
+    n += std::snprintf(buffer + n, sizeof(buffer) - static_cast<size_t>(n),
+                       ", %llu lines, %.0f lines/s, %.1f MB/s, %llu differing lines",
+                       static_cast<unsigned long long>(lines), static_cast<double>(lines) / rate_base,
+                       mb / rate_base, static_cast<unsigned long long>(diff_lines));
+    if (done) {
+        n += std::snprintf(buffer + n, sizeof(buffer) - static_cast<size_t>(n), ", done in %.1f s", elapsed);
+    } else if (total_bytes_ > bytes && bytes > 0) {
+        // Time left at the average rate so far
+        auto left = static_cast<unsigned long long>(static_cast<double>(total_bytes_ - bytes) /
+                                                    (static_cast<double>(bytes) / rate_base));
+        n += std::snprintf(buffer + n, sizeof(buffer) - static_cast<size_t>(n), ", ETA %llu:%02llu:%02llu",
+                           left / 3600, left / 60 % 60, left % 60);
+    }
+    size_t width = static_cast<size_t>(n);
+    if (rewrite_) {
+        // Overwrite the previous report, blanking what is left of it
+        os_ << '\r' << buffer;
+        for (size_t i = width; i < last_width_; ++i) os_ << ' ';
+        last_width_ = width;
+        if (done) os_ << '\n';
+    } else {
+        os_ << buffer << '\n';
+    }
+    os_.flush();
+}
@@ -0,0 +1,186 @@
+// RecordWriter.cpp
+// -------------------------------------------------------------
+// This file implements the RecordWriter class: JSON Lines and CSV record
+// formatting, output caps and buffering.
+//
+// JSON Lines:
+//   {"type":"cell","line":L,"column":C,"value1":V1,"value2":V2,"percent_error":E}
+//   {"type":"summary","file1":"...","file2":"...","lines":N,"differing_lines":D,
+//    "max_percent_error":E,"records":R,"dropped_records":X,"truncated":false}
+// CSV (one table: cell rows leave the summary columns empty and vice versa):
+//   type,line,column,value1,value2,percent_error,file1,file2,lines,differing_lines,
+//     max_percent_error,records,dropped_records,truncated
+//   cell,L,C,V1,V2,E,,,,,,,,
+//   summary,,,,,,file1,file2,N,D,E,R,X,false
+// -------------------------------------------------------------
+
+#include "diff-numerics/RecordWriter.h"
+#include <charconv>
+#include <cmath>
+
+namespace {
+const size_t kBufferSize = 1 << 16;
+
+// Append a number in shortest round-trip form; JSON has no inf or nan, they become null
+void appendNumber(std::string& out, double value, bool json) {
+    if (json && !std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+    char buffer[32];
+    auto res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, res.ptr);
+}
+
+void appendNumber(std::string& out, uint64_t value) {
+    char buffer[24];
+    auto res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, res.ptr);
+}
+
+// Append a JSON string literal
+void appendJsonString(std::string& out, std::string_view text) {
+    static const char* const kHex = "0123456789abcdef";
+    out += '"';
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (u < 0x20) {
+            out += "\\u00";
+            out += kHex[u >> 4];
+            out += kHex[u & 0xf];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Append a CSV field, quoted (RFC 4180) if it contains a separator, quote or newline
+void appendCsvField(std::string& out, std::string_view text) {
+    if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out += text;
+        return;
+    }
+    out += '"';
+    for (char c : text) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+}  // namespace
+
+// Constructor: the buffer is allocated once
+RecordWriter::RecordWriter(std::ostream& out, Format format, uint64_t max_bytes, uint64_t max_records)
+    : out_(out), format_(format), max_bytes_(max_bytes), max_records_(max_records) {
+    buffer_.reserve(kBufferSize);
+}
+
+void RecordWriter::header() {
+    if (format_ == Format::Csv) {
+        buffer_ += "type,line,column,value1,value2,percent_error,file1,file2,lines,differing_lines,"
+                   "max_percent_error,records,dropped_records,truncated\n";
+    }
+}
+
+// Format one cell record; nothing is formatted once a cap has been hit
+void RecordWriter::cell(size_t line, size_t column, double value1, double value2, double percent_error) {
+    if (dropped_ > 0) {
+        ++dropped_;
+        return;
+    }
+    const bool json = format_ == Format::Jsonl;
+    record_.clear();
+    record_ += json ? "{\"type\":\"cell\",\"line\":" : "cell,";
+    appendNumber(record_, static_cast<uint64_t>(line));
+    record_ += json ? ",\"column\":" : ",";
+    appendNumber(record_, static_cast<uint64_t>(column));
+    record_ += json ? ",\"value1\":" : ",";
+    appendNumber(record_, value1, json);
+    record_ += json ? ",\"value2\":" : ",";
+    appendNumber(record_, value2, json);
+    record_ += json ? ",\"percent_error\":" : ",";
+    appendNumber(record_, percent_error, json);
+    record_ += json ? "}\n" : ",,,,,,,,\n";  // CSV: empty summary columns
+    commit();
+}
+
+// Split records written by another writer at newlines and commit them one by one
+void RecordWriter::append(std::string_view records) {
+    size_t start = 0;
+    while (start < records.size()) {
+        size_t end = records.find('\n', start);
+        end = (end == std::string_view::npos) ? records.size() : end + 1;
+        if (dropped_ > 0) {
+            ++dropped_;
+        } else {
+            record_.assign(records.substr(start, end - start));
+            commit();
+        }
+        start = end;
+    }
+}
+
+// Keep the record if neither cap is exceeded; otherwise drop it and all that follow
+void RecordWriter::commit() {
+    if ((max_records_ > 0 && records_ >= max_records_) ||
+        (max_bytes_ > 0 && bytes_ + record_.size() > max_bytes_)) {
+        ++dropped_;
+        return;
+    }
+    buffer_ += record_;
+    bytes_ += record_.size();
+    ++records_;
+    if (buffer_.size() >= kBufferSize) flush();
+}
+
+void RecordWriter::summary(const Summary& summary) {
+    const bool json = format_ == Format::Jsonl;
+    if (json) {
+        buffer_ += "{\"type\":\"summary\",\"file1\":";
+        appendJsonString(buffer_, summary.file1);
+        buffer_ += ",\"file2\":";
+        appendJsonString(buffer_, summary.file2);
+        buffer_ += ",\"lines\":";
+    } else {
+        // Empty cell columns, then the summary columns
+        buffer_ += "summary,,,,,,";
+        appendCsvField(buffer_, summary.file1);
+        buffer_ += ',';
+        appendCsvField(buffer_, summary.file2);
+        buffer_ += ',';
+    }
+    appendNumber(buffer_, static_cast<uint64_t>(summary.lines));
+    buffer_ += json ? ",\"differing_lines\":" : ",";
+    appendNumber(buffer_, static_cast<uint64_t>(summary.differing_lines));
+    buffer_ += json ? ",\"max_percent_error\":" : ",";
+    appendNumber(buffer_, summary.max_percent_error, json);
+    buffer_ += json ? ",\"records\":" : ",";
+    appendNumber(buffer_, records_);
+    buffer_ += json ? ",\"dropped_records\":" : ",";
+    appendNumber(buffer_, dropped_);
+    buffer_ += json ? ",\"truncated\":" : ",";
+    buffer_ += dropped_ > 0 ? "true" : "false";
+    buffer_ += json ? "}\n" : "\n";
+    flush();
+}
+
+void RecordWriter::flush() {
+    if (buffer_.empty()) return;
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+}
+
+bool RecordWriter::parseFormat(const std::string& name, Format& format) {
+    if (name == "jsonl") {
+        format = Format::Jsonl;
+    } else if (name == "csv") {
+        format = Format::Csv;
+    } else {
+        return false;
+    }
+    return true;
+}
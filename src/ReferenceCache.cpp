@@ -0,0 +1,113 @@
+// ReferenceCache.cpp
+// -------------------------------------------------------------
+// This file implements the ReferenceCache class.
+// -------------------------------------------------------------
+
+#include "diff-numerics/ReferenceCache.h"
+#include <fstream>
+#include <sys/stat.h>
+
+namespace {
+// Modification time (ns) and size of a file; false if it cannot be stat'ed
+bool fileStamp(const std::string& path, int64_t& mtime_ns, uint64_t& size) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+}  // namespace
+
+// Constructor: set the memory budget
+ReferenceCache::ReferenceCache(size_t budget_bytes) : budget_bytes_(budget_bytes) {}
+
+// Look up a file; stale entries (different mtime or size) are reloaded
+std::shared_ptr<const ParsedText> ReferenceCache::get(const std::string& path,
+                                                      const std::string& comment) {
+    int64_t mtime_ns = 0;
+    uint64_t size = 0;
+    if (!fileStamp(path, mtime_ns, size)) return nullptr;
+    Key key(path, comment);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            if (it->second.mtime_ns == mtime_ns && it->second.size == size) {
+                ++hits_;
+                lru_.splice(lru_.begin(), lru_, it->second.lru);
+                return it->second.data;
+            }
+            bytes_ -= it->second.data->bytes();
+            lru_.erase(it->second.lru);
+            entries_.erase(it);
+        }
+        ++misses_;
+    }
+
+    // Load and parse outside the lock, so that other jobs are not blocked by disk I/O
+    std::shared_ptr<const ParsedText> data = load(path, comment);
+    if (!data || data->bytes() > budget_bytes_) return data;  // Too big to cache: use once
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(key) != 0) return data;  // Loaded concurrently by another job
+    lru_.push_front(key);
+    Entry& entry = entries_[key];
+    entry.data = data;
+    entry.mtime_ns = mtime_ns;
+    entry.size = size;
+    entry.lru = lru_.begin();
+    bytes_ += data->bytes();
+    evict();
+    return data;
+}
+
+// Read the file line by line, dropping comment lines (same rule as NumericDiff), and
+// parse the rest
+std::shared_ptr<const ParsedText> ReferenceCache::load(const std::string& path,
+                                                       const std::string& comment) {
+    std::ifstream fin(path);
+    if (!fin.is_open()) return nullptr;
+    std::string data;
+    std::string line;
+    while (std::getline(fin, line)) {
+        if (!comment.empty()) {
+            size_t pos = line.find_first_not_of(" \t");
+            if (pos != std::string::npos && line.compare(pos, comment.size(), comment) == 0) continue;
+        }
+        data += line;
+        data += '\n';
+    }
+    data.shrink_to_fit();
+    return ParsedText::parse(std::move(data));
+}
+
+// Evict from the least recently used end; entries still in use by running jobs stay
+// alive through their shared pointers
+void ReferenceCache::evict() {
+    while (bytes_ > budget_bytes_ && !lru_.empty()) {
+        auto it = entries_.find(lru_.back());
+        bytes_ -= it->second.data->bytes();
+        entries_.erase(it);
+        lru_.pop_back();
+    }
+}
+
+size_t ReferenceCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+size_t ReferenceCache::entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t ReferenceCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+size_t ReferenceCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
@@ -0,0 +1,30 @@
+// StyledLine.cpp
+// -------------------------------------------------------------
+// This file implements the StyledLine class: writing a line with its
+// highlights turned into ANSI escape codes, in one pass over the text.
+// -------------------------------------------------------------
+
+#include "diff-numerics/StyledLine.h"
+#include <algorithm>
+
+// Write the visible prefix of the line. Highlights starting within the prefix
+// (including one starting exactly at the cut) are opened and closed, as a terminal
+// reading the truncated line must not be left in red.
+void StyledLine::write(std::ostream& os, bool color, size_t max_width) const {
+    size_t end = std::min(max_width, text_.size());
+    if (!color || runs_.empty()) {
+        os.write(text_.data(), static_cast<std::streamsize>(end));
+        return;
+    }
+    size_t pos = 0;
+    for (const auto& run : runs_) {
+        if (run.first > end) break;
+        size_t run_end = std::min(run.second, end);
+        os.write(text_.data() + pos, static_cast<std::streamsize>(run.first - pos));
+        os << kRed;
+        os.write(text_.data() + run.first, static_cast<std::streamsize>(run_end - run.first));
+        os << kReset;
+        pos = run_end;
+    }
+    os.write(text_.data() + pos, static_cast<std::streamsize>(end - pos));
+}
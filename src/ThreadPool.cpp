@@ -0,0 +1,78 @@
+// ThreadPool.cpp
+// -------------------------------------------------------------
+// This file implements the ThreadPool class.
+// -------------------------------------------------------------
+
+#include "diff-numerics/ThreadPool.h"
+#include <utility>
+
+// Constructor: start the workers
+ThreadPool::ThreadPool(size_t n) {
+    if (n <= 1) return;
+    workers_.reserve(n);
+    for (size_t i = 0; i < n; ++i) workers_.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+// Destructor: let the workers drain the queue, then join them
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    task_ready_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+// Queue a task, or run it right away when there are no workers
+void ThreadPool::submit(std::function<void()> task) {
+    if (workers_.empty()) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    task_ready_.notify_one();
+}
+
+// Wait until the queue is empty and no task is running
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return tasks_.empty() && running_ == 0; });
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+// Resolve the job count: 0 means one thread per hardware thread
+size_t ThreadPool::resolveJobs(size_t jobs) {
+    if (jobs > 0) return jobs;
+    size_t hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+// Worker: pop and run tasks until the pool is stopped and the queue is empty
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            task_ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            ++running_;
+        }
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error && !error_) error_ = error;
+            --running_;
+            if (tasks_.empty() && running_ == 0) all_done_.notify_all();
+        }
+    }
+}
@@ -2,19 +2,36 @@
 // -------------------------------------------------------------
 // This is the main entry point for the diff-numerics command-line tool.
 // It parses command-line arguments, configures options, and runs the
-// NumericDiff class to compare two numerical data files.
+// NumericDiff class to compare two numerical data files, either locally or
+// on a comparison server (see ComparisonServer).
 //
 // Usage and options are printed if arguments are missing or invalid.
 // -------------------------------------------------------------
 
+#include <atomic>
 #include <iostream>
+#include <new>
 #include <string>
 #include <vector>
 #include <cstdlib>
 #include <set>
 #include <sstream>
+#include "diff-numerics/ComparisonServer.h"
 #include "diff-numerics/NumericDiff.h"
 #include "diff-numerics/NumericDiffOption.h"
+#include "diff-numerics/Profiler.h"
+
+// Heap allocations made through operator new, reported by --profile
+static std::atomic<uint64_t> g_heap_allocations{0};
+
+void* operator new(std::size_t size) {
+    g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
 
 int main(int argc, char* argv[]) {
     for (int i = 1; i < argc; ++i) {
@@ -27,7 +44,35 @@ int main(int argc, char* argv[]) {
     NumericDiffOption opts;
     if (!opts.parse(argc, argv)) return 1;
     if (!opts.validate()) return 1;
-    
+    Profiler::setAllocationCounter([] { return g_heap_allocations.load(); });
+
+    if (!opts.serve_socket.empty()) {
+        ComparisonServer server(opts.serve_socket, opts.cache_mb << 20, opts.jobs);  // Bounded by validate()
+        return server.serve();
+    }
+
+    // Client mode: run on a server if one is given, falling back to a local run only
+    // when it comes from the environment
+    const char* env_socket = std::getenv("DIFF_NUMERICS_SERVER");
+    std::string socket = !opts.connect_socket.empty() ? opts.connect_socket
+                                                      : (env_socket ? env_socket : "");
+    if (!socket.empty()) {
+        int exit_code = 0;
+        if (ComparisonServer::runClient(socket, argc, argv, exit_code)) return exit_code;
+        if (!opts.connect_socket.empty()) {
+            std::cerr << "Error: Cannot reach comparison server on '" << socket << "'\n";
+            return -1;
+        }
+    }
+
     NumericDiff diff(opts);
-    return diff.run();
+    if (opts.profile.empty()) return diff.run();
+
+    Profiler profiler(opts.perf_counters);
+    diff.setProfiler(&profiler);
+    profiler.start();
+    int result = diff.run();
+    profiler.stop();
+    profiler.report(std::cerr, opts.profile == "json");
+    return result;
 }
\ No newline at end of file
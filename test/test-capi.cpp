@@ -0,0 +1,64 @@
+// test-capi.cpp
+// -------------------------------------------------------------
+// This file contains the tests of the C interface. They are linked against
+// the libdiffnumerics shared library, so only its exported dn_* functions
+// are reachable, as from a host program.
+// -------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "diff-numerics/CApi.h"
+#include <filesystem>
+#include <string>
+
+// Test: a comparator compares C and Fortran order arrays and text buffers, and reports errors
+TEST(CApi, ComparesCallerBuffers) {
+    const char* args[] = {"-t", "1", "-T", "1e-12"};
+    dn_comparator* comparator = dn_create(4, args);
+    ASSERT_NE(comparator, nullptr);
+    EXPECT_EQ(dn_api_version(), DN_API_VERSION);
+
+    // 3x2 arrays: C order, and the same values in Fortran (column-major) order but one
+    const double c_order[] = {1.0, 10.0, 2.0, 20.0, 3.0, 30.0};
+    const double fortran_order[] = {1.0, 2.0, 3.0, 10.0, 25.0, 30.0};
+    dn_array array1 = {c_order, 3, 2, 2, 1};
+    dn_array array2 = {fortran_order, 3, 2, 1, 3};
+    dn_result result = {99, 99, 99.0};
+    dn_column_stats stats[3];
+    EXPECT_EQ(dn_compare_arrays(comparator, &array1, &array2, &result, stats, 3), 1);
+    EXPECT_EQ(result.lines, 3u);
+    EXPECT_EQ(result.differing_lines, 1u);
+    EXPECT_DOUBLE_EQ(result.max_percent_error, 20.0);
+    EXPECT_EQ(stats[0].differing_cells, 0u);
+    EXPECT_EQ(stats[0].first_differing_line, 0u);
+    EXPECT_EQ(stats[1].differing_cells, 1u);
+    EXPECT_EQ(stats[1].first_differing_line, 2u);
+    EXPECT_DOUBLE_EQ(stats[1].max_percent_error, 20.0);
+    EXPECT_EQ(stats[2].differing_cells, 0u);
+
+    std::string text1 = "# x y\n1.0 10.0\n2.0 20.0\n", text2 = "1.0 10.0\n2.0 20.5\n";
+    EXPECT_EQ(dn_compare_text(comparator, text1.data(), text1.size(), text2.data(), text2.size(), &result,
+                              nullptr, 0),
+              1);
+    EXPECT_EQ(result.lines, 2u);
+    array2.rows = 2;
+    EXPECT_EQ(dn_compare_arrays(comparator, &array1, &array2, nullptr, nullptr, 0), -1);
+    EXPECT_EQ(std::string(dn_last_error(comparator)), "Error: Shape mismatch: 'array1' is 3x2, 'array2' is 2x2");
+    dn_destroy(comparator);
+
+    // The block index is a file cache: comparators of buffers never write it
+    std::string index = (std::filesystem::temp_directory_path() / "dn_capi_index.txt").string();
+    std::filesystem::remove(index);
+    const char* index_args[] = {"--block-index", index.c_str()};
+    comparator = dn_create(2, index_args);
+    EXPECT_EQ(dn_compare_text(comparator, text1.data(), text1.size(), text2.data(), text2.size(), nullptr,
+                              nullptr, 0),
+              1);
+    EXPECT_FALSE(std::filesystem::exists(index));
+    dn_destroy(comparator);
+
+    const char* bad_args[] = {"--column-policy", "1:abs"};
+    comparator = dn_create(2, bad_args);
+    EXPECT_EQ(dn_compare_text(comparator, "1", 1, "1", 1, nullptr, nullptr, 0), -1);
+    EXPECT_EQ(std::string(dn_last_error(comparator)), "Error: Column policy '1:abs' needs a tolerance.");
+    dn_destroy(comparator);
+}
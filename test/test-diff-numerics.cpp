@@ -10,14 +10,41 @@
 
 #include <gtest/gtest.h>
 #include "diff-numerics/NumericDiff.h"
+#include "diff-numerics/ComparisonServer.h"
+#include "diff-numerics/FieldReader.h"
+#include "diff-numerics/Profiler.h"
+#include "diff-numerics/Progress.h"
+#include "diff-numerics/StyledLine.h"
+#include "diff-numerics/ThreadPool.h"
 #include <fstream>
 #include <filesystem>
 #include <cstdio>
 #include <array>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <limits>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
+// Heap allocations made through operator new, counted to check that comparisons
+// do not allocate per line
+static std::atomic<size_t> g_heap_allocations{0};
+
+void* operator new(std::size_t size) {
+    g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
 // Helper to copy test data to a temp file (not used in current tests)
 void copy_file(const std::string& src, const std::string& dst) {
     std::ifstream in(src);
@@ -234,6 +261,7 @@ TEST(DiffNumerics, ColorDifferentDigits) {
     opts.threshold = 1E-6;
     opts.side_by_side = true;
     opts.color_diff_digits = true;
+    opts.color = "always";
     NumericDiff diff(opts);
     diff.run();
     std::string output = testing::internal::GetCapturedStdout();
@@ -268,3 +296,821 @@ TEST(DiffNumerics, P2F2_Columns1_2_4_Equal) {
 }
 
 // Add more tests for different tolerances, thresholds, and options as needed
+
+// Helper to write a temporary data file and return its path
+std::string write_temp_file(const std::string& name, const std::string& content) {
+    fs::path path = fs::temp_directory_path() / name;
+    std::ofstream out(path);
+    out << content;
+    return path.string();
+}
+
+// Helper: parse and validate command-line arguments (file names appended unless serving),
+// errors into err
+static bool parse_options(std::vector<std::string> args, std::ostream& err) {
+    bool serve = std::find(args.begin(), args.end(), "--serve") != args.end();
+    args.insert(args.begin(), "diff-numerics");
+    if (!serve) {
+        args.push_back("a.dat");
+        args.push_back("b.dat");
+    }
+    std::vector<char*> argv;
+    for (auto& arg : args) argv.push_back(arg.data());
+    NumericDiffOption opts;
+    return opts.parse(static_cast<int>(argv.size()), argv.data(), err) && opts.validate(err);
+}
+
+// Test: Count options are parsed strictly and bounded, instead of wrapping around
+TEST(NumericDiffOption, RejectsInvalidCounts) {
+    std::ostringstream err;
+    EXPECT_TRUE(parse_options({"--block-index", "ix", "--block-size", "128"}, err));
+    for (const char* size : {"-1", "0", "12x", "", "99999999999", "+5"}) {
+        err.str("");
+        EXPECT_FALSE(parse_options({"--block-size", size}, err)) << size;
+        EXPECT_EQ(err.str().rfind("Error: ", 0), 0u) << size;
+    }
+    EXPECT_TRUE(parse_options({"-b", "-j", "0"}, err));
+    EXPECT_TRUE(parse_options({"-b", "-j", "1024"}, err));
+    for (const char* jobs : {"-1", "1025", "4x", "18446744073709551616"}) {
+        err.str("");
+        EXPECT_FALSE(parse_options({"-b", "-j", jobs}, err)) << jobs;
+        EXPECT_EQ(err.str().rfind("Error: ", 0), 0u) << jobs;
+    }
+    EXPECT_TRUE(parse_options({"--format", "csv", "--max-records", "0", "--max-output-bytes", "4096"}, err));
+    for (const char* cap : {"abc", "-1", "1e6", "18446744073709551616"}) {
+        for (const char* option : {"--max-records", "--max-output-bytes"}) {
+            err.str("");
+            EXPECT_FALSE(parse_options({"--format", "jsonl", option, cap}, err)) << option << " " << cap;
+            EXPECT_EQ(err.str().rfind("Error: ", 0), 0u) << option << " " << cap;
+        }
+    }
+    EXPECT_TRUE(parse_options({"--serve", "dn.sock", "--cache-size", "17592186044415"}, err));
+    for (const char* size : {"abc", "-1", "17592186044416", "18446744073709551615"}) {
+        err.str("");
+        EXPECT_FALSE(parse_options({"--serve", "dn.sock", "--cache-size", size}, err)) << size;
+        EXPECT_EQ(err.str().rfind("Error: ", 0), 0u) << size;
+    }
+    EXPECT_TRUE(parse_options({"--wide-rows", "1048576"}, err));
+    for (const char* columns : {"0", "-5", "abc", "1048577"}) {
+        err.str("");
+        EXPECT_FALSE(parse_options({"--wide-rows", columns}, err)) << columns;
+        EXPECT_EQ(err.str().rfind("Error: ", 0), 0u) << columns;
+    }
+}
+
+// Test: Block index skips block pairs verified equal at the same position in a previous
+// run, re-checks changed ones and does not grow
+TEST(DiffNumerics, BlockIndexSkipsVerifiedBlocks) {
+    std::string file1 = write_temp_file("dn_block1.dat", "1 2\n3 4\n# comment\n5 6\n7 8\n9 10\n11 12\n");
+    std::string file2 = write_temp_file("dn_block2.dat", "1 2\n3 5\n5 6\n7 8\n9 10\n11 12\n");
+    std::string index = (fs::temp_directory_path() / "dn_block.idx").string();
+    fs::remove(index);
+    NumericDiffOption opts;
+    opts.file1 = file1;
+    opts.file2 = file2;
+    opts.only_equal = true;
+    opts.block_index = index;
+    opts.block_size = 2;
+
+    testing::internal::CaptureStdout();
+    NumericDiff first(opts);
+    EXPECT_EQ(first.run(), 1);
+    EXPECT_EQ(first.skippedBlocks(), 0u);
+    NumericDiff second(opts);
+    EXPECT_EQ(second.run(), 1);
+    EXPECT_EQ(second.skippedBlocks(), 2u);
+
+    // Changing a verified block forces it to be compared again
+    write_temp_file("dn_block2.dat", "1 2\n3 5\n5 6\n7 9\n9 10\n11 12\n");
+    NumericDiff third(opts);
+    EXPECT_EQ(third.run(), 2);
+    EXPECT_EQ(third.skippedBlocks(), 1u);
+
+    // A different tolerance invalidates the whole index
+    opts.tolerance = 50.0;
+    NumericDiff fourth(opts);
+    EXPECT_EQ(fourth.run(), 0);
+    EXPECT_EQ(fourth.skippedBlocks(), 0u);
+
+    // Entries are kept per block position: a verified block moved elsewhere is compared
+    // again, and the index holds at most one entry per block of the files
+    auto entries = [&index]() {
+        std::ifstream in(index);
+        size_t lines = 0;
+        for (std::string line; std::getline(in, line);) ++lines;
+        return lines - 3;  // Header lines
+    };
+    EXPECT_EQ(entries(), 3u);
+    for (const std::string& data : {"1 2\n3 4\n5 6\n7 8\n9 10\n11 12\n", "1 2\n3 4\n9 10\n11 12\n5 6\n7 8\n"}) {
+        write_temp_file("dn_block1.dat", data);
+        write_temp_file("dn_block2.dat", data);
+        NumericDiff moved(opts);
+        EXPECT_EQ(moved.run(), 0);
+        EXPECT_EQ(moved.skippedBlocks(), 1u);
+        EXPECT_EQ(entries(), 3u);
+    }
+    // Entries past the end of shortened files are dropped
+    write_temp_file("dn_block1.dat", "1 2\n3 4\n");
+    write_temp_file("dn_block2.dat", "1 2\n3 4\n");
+    NumericDiff shortened(opts);
+    EXPECT_EQ(shortened.run(), 0);
+    EXPECT_EQ(shortened.skippedBlocks(), 1u);
+    EXPECT_EQ(entries(), 1u);
+    testing::internal::GetCapturedStdout();
+    fs::remove(index);
+}
+
+// Test: Every specialised comparison kernel writes the same output as the generic path
+// (no projection, policies or profiling), and options a mode ignores change nothing
+TEST(DiffNumerics, KernelsAgreeOnOutput) {
+    auto run = [](const NumericDiffOption& mode, bool profile) {
+        std::ostringstream out, err;
+        NumericDiff diff(mode);
+        diff.setOutput(out, err);
+        Profiler profiler;
+        if (profile) diff.setProfiler(&profiler);
+        int code = diff.run();
+        return std::to_string(code) + "\n" + out.str() + err.str();
+    };
+    // Differences in every column, non-numeric and missing cells, values under the threshold
+    std::string file1 = write_temp_file("dn_kernels1.dat", "1.0 2.0 abc 4.0\n0.5 0.25 1e3 x\n\n7 8 9\n"
+                                                           "0.0 1e-7 5 6\n1 2 3 4\n");
+    std::string file2 = write_temp_file("dn_kernels2.dat", "1.5 2.0 abd 4.1\n0.5 0.26 1000 x\n1 2\n7 8 9.5\n"
+                                                           "0.0 3e-7 5.5 6.0001\n");
+    std::vector<std::pair<std::string, std::string>> inputs = {
+        {test_data_path("delta_3P2-3F2.dat"), test_data_path("delta_3P2-3F2_2.dat")}, {file1, file2}};
+    for (const auto& [path1, path2] : inputs) {
+        NumericDiffOption opts;
+        opts.file1 = path1;
+        opts.file2 = path2;
+        opts.color = "always";
+        std::string reference = run(opts, false);
+        std::string expected = reference.substr(0, reference.find('\n'));  // Differing lines
+        EXPECT_NE(expected, "0");
+        for (int mask = 0; mask < 32; ++mask) {
+            NumericDiffOption mode = opts;
+            mode.color_diff_digits = (mask & 1) != 0;
+            mode.only_equal = (mask & 2) != 0;
+            mode.side_by_side = (mask & 4) != 0;
+            mode.suppress_common_lines = (mask & 8) != 0;
+            mode.output_format = (mask & 16) ? "jsonl" : "text";
+            std::string generic = run(mode, false);
+            EXPECT_EQ(generic.substr(0, generic.find('\n')), expected) << path2 << " mode mask " << mask;
+            // Every column, a policy equal to the defaults and profiling take the other
+            // branches of the kernels
+            NumericDiffOption variant = mode;
+            variant.columns_to_compare = {1, 2, 3, 4};
+            variant.column_policies = {"1,2,3,4:rel:1e-2:1e-6"};
+            EXPECT_EQ(run(variant, true), generic) << path2 << " mode mask " << mask;
+            // Summaries and records have no layout
+            if (mode.only_equal || mode.output_format != "text") {
+                NumericDiffOption plain = mode;
+                plain.color_diff_digits = false;
+                plain.side_by_side = false;
+                plain.suppress_common_lines = false;
+                EXPECT_EQ(run(plain, false), generic) << path2 << " mode mask " << mask;
+            }
+        }
+    }
+}
+
+// Test: Column projection only looks at the selected columns of wide lines
+TEST(DiffNumerics, ColumnProjectionWideLines) {
+    std::string line1, line2;
+    for (int i = 1; i <= 500; ++i) {
+        line1 += std::to_string(i) + ".5 ";
+        line2 += (i == 400 ? std::string("999") : std::to_string(i) + ".5") + " ";
+    }
+    std::string file1 = write_temp_file("dn_wide1.dat", line1 + "\n" + line1 + "\n1.0 2.0\n");
+    std::string file2 = write_temp_file("dn_wide2.dat", line1 + "\n" + line2 + "\n1.0 2.0\n");
+    NumericDiffOption opts;
+    opts.file1 = file1;
+    opts.file2 = file2;
+    opts.columns_to_compare = {2, 3};
+    opts.color = "always";
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(NumericDiff(opts).run(), 0);
+    opts.columns_to_compare = {3, 400};
+    EXPECT_EQ(NumericDiff(opts).run(), 1);
+    std::string output = testing::internal::GetCapturedStdout();
+    // Only the selected columns are printed
+    EXPECT_NE(output.find("< 3.5 \033[31m400.5\033[0m"), std::string::npos);
+    EXPECT_NE(output.find("> 3.5 \033[31m999\033[0m"), std::string::npos);
+}
+
+// Test: Wide-row mode gives the same statistics as line mode, across segment boundaries
+TEST(DiffNumerics, WideRowsMatchLineMode) {
+    std::string line1, line2;
+    for (int i = 1; i <= 500; ++i) {
+        line1 += std::to_string(i) + ".5 ";
+        line2 += (i == 400 ? std::string("999") : std::to_string(i) + ".5") + " ";
+    }
+    std::string file1 = write_temp_file("dn_wrows1.dat", "# header\n" + line1 + "\n" + line1 + "\n1 2 3\n");
+    std::string file2 = write_temp_file("dn_wrows2.dat", line1 + "\n  # comment\n" + line2 + "\n1 2\n4\n");
+    NumericDiffOption opts;
+    opts.file1 = file1;
+    opts.file2 = file2;
+    opts.only_equal = true;
+    testing::internal::CaptureStdout();
+    int expected = NumericDiff(opts).run();
+    for (size_t segment : {1, 7, 100, 500, 4096}) {
+        opts.wide_row_columns = segment;
+        opts.columns_to_compare.clear();
+        EXPECT_EQ(NumericDiff(opts).run(), expected) << "segment " << segment;
+        opts.columns_to_compare = {3, 400};
+        EXPECT_EQ(NumericDiff(opts).run(), 1) << "segment " << segment;
+        opts.columns_to_compare = {3, 399};
+        EXPECT_EQ(NumericDiff(opts).run(), 0) << "segment " << segment;
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+    EXPECT_EQ(expected, 1);
+    EXPECT_NE(output.find("max percentage error: 59.9"), std::string::npos);
+}
+
+// Test: FieldReader splits fields correctly across buffer refills and skips comments
+TEST(FieldReader, SegmentsAcrossBufferRefills) {
+    std::istringstream in("  # comment line\n1.0 22.5\t333.25   4e-3\n\n#x\n5 6");
+    FieldReader reader(in, 16);
+    std::vector<std::string_view> tokens;
+    std::vector<bool> all;
+    ASSERT_TRUE(reader.nextLine("#"));
+    EXPECT_EQ(reader.readFields(3, all, 0, tokens), 3u);
+    ASSERT_EQ(tokens.size(), 3u);
+    EXPECT_EQ(tokens[0], "1.0");
+    EXPECT_EQ(tokens[2], "333.25");
+    EXPECT_EQ(reader.readFields(3, all, 3, tokens), 1u);
+    EXPECT_EQ(tokens[0], "4e-3");
+    reader.skipLine();
+    ASSERT_TRUE(reader.nextLine("#"));
+    EXPECT_EQ(reader.readFields(3, all, 0, tokens), 0u);
+    reader.skipLine();
+    ASSERT_TRUE(reader.nextLine("#"));
+    std::vector<bool> second_only = {false, true};
+    EXPECT_EQ(reader.readFields(3, second_only, 0, tokens), 2u);
+    ASSERT_EQ(tokens.size(), 1u);
+    EXPECT_EQ(tokens[0], "6");
+    reader.skipLine();
+    EXPECT_FALSE(reader.nextLine("#"));
+}
+
+// Test: Block mode reports which blank-line-separated block differs, independently of thread count
+TEST(DiffNumerics, BlocksPerBlockSummary) {
+    std::string data1, data2;
+    for (int block = 0; block < 12; ++block) {
+        for (int i = 0; i < 3; ++i) {
+            std::string row = std::to_string(block) + " " + std::to_string(i) + ".25\n";
+            data1 += row;
+            data2 += (block == 5 && i == 1) ? std::to_string(block) + " 7.5\n" : row;
+        }
+        data1 += "\n\n";
+        data2 += "\n";
+    }
+    std::string file1 = write_temp_file("dn_blocks1.dat", "# scan\n" + data1);
+    std::string file2 = write_temp_file("dn_blocks2.dat", data2);
+    NumericDiffOption opts;
+    opts.file1 = file1;
+    opts.file2 = file2;
+    opts.blocks = true;
+    opts.jobs = 1;
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(NumericDiff(opts).run(), 1);
+    std::string serial = testing::internal::GetCapturedStdout();
+    EXPECT_NE(serial.find("Block 5: 1 lines differ, max percentage error: 83.3333%"), std::string::npos);
+    EXPECT_EQ(serial.find("Block 4:"), std::string::npos);
+
+    opts.jobs = 4;
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(NumericDiff(opts).run(), 1);
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), serial);
+}
+
+// Helper to write a little-endian float64 .npy (v1.0) file with the given shape
+std::string write_npy(const std::string& name, const std::string& shape, const std::vector<double>& values) {
+    std::string header = "{'descr': '<f8', 'fortran_order': False, 'shape': " + shape + ", }";
+    while ((10 + header.size() + 1) % 64 != 0) header += ' ';
+    header += '\n';
+    std::string content = std::string("\x93NUMPY\x01\x00", 8);
+    content += static_cast<char>(header.size() & 0xff);
+    content += static_cast<char>(header.size() >> 8);
+    content += header;
+    content.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+    return write_temp_file(name, content);
+}
+
+std::string write_npy(const std::string& name, size_t rows, size_t cols, const std::vector<double>& values) {
+    return write_npy(name, "(" + std::to_string(rows) + ", " + std::to_string(cols) + ")", values);
+}
+
+// Test: Binary inputs (.npy, raw doubles) compare directly and against text, with shape checks
+TEST(DiffNumerics, BinaryArrayInputs) {
+    std::vector<double> values = {1.0, 2.5, 3.0, 4.0, 5.0, 6.0};
+    std::vector<double> changed = {1.0, 2.5, 3.0, 4.0, 5.0, 6.5};
+    std::string npy = write_npy("dn_array.npy", 3, 2, values);
+    std::string raw = write_temp_file("dn_array.f64", std::string(reinterpret_cast<const char*>(changed.data()), changed.size() * sizeof(double)));
+    std::string text = write_temp_file("dn_array.dat", "# x y\n1 2.5\n3.0 4\n5 6\n");
+    NumericDiffOption opts;
+    opts.raw_columns = 2;
+    opts.color = "always";
+    testing::internal::CaptureStdout();
+    opts.file1 = npy;
+    opts.file2 = text;
+    EXPECT_EQ(NumericDiff(opts).run(), 0);
+    opts.file2 = raw;
+    EXPECT_EQ(NumericDiff(opts).run(), 1);
+    opts.columns_to_compare = {1};
+    EXPECT_EQ(NumericDiff(opts).run(), 0);
+    opts.columns_to_compare.clear();
+    opts.file1 = text;
+    EXPECT_EQ(NumericDiff(opts).run(), 1);
+    std::string output = testing::internal::GetCapturedStdout();
+    EXPECT_NE(output.find("< 5 \033[31m6\033[0m"), std::string::npos);
+    EXPECT_NE(output.find("> 5 \033[31m6.5\033[0m"), std::string::npos);
+
+    // Shape mismatches are errors
+    opts.raw_columns = 3;
+    opts.file1 = npy;
+    EXPECT_EQ(NumericDiff(opts).run(), -1);
+    opts.file2 = write_temp_file("dn_array_short.dat", "1 2.5\n3 4\n");
+    EXPECT_EQ(NumericDiff(opts).run(), -1);
+
+    // Crafted headers and row widths are errors, not exceptions or reads past the mapping
+    std::ostringstream out, err;
+    opts.file2 = npy;
+    for (const char* shape : {"(99999999999999999999999, 2)", "(2305843009213693952, 8)", "(-3, 2)", "(3x, 2)"}) {
+        opts.file1 = write_npy("dn_array_bad.npy", shape, values);
+        NumericDiff bad(opts);
+        bad.setOutput(out, err);
+        EXPECT_EQ(bad.run(), -1) << shape;
+    }
+    opts.file1 = raw;
+    opts.raw_columns = 2305843009213693952u;  // columns * sizeof(double) wraps to 0
+    NumericDiff wide(opts);
+    wide.setOutput(out, err);
+    EXPECT_EQ(wide.run(), -1);
+    EXPECT_NE(err.str().find("malformed shape in .npy header"), std::string::npos);
+    EXPECT_NE(err.str().find("is not a whole number of rows"), std::string::npos);
+
+    err.str("");
+    EXPECT_FALSE(parse_options({"--raw-columns", "-1"}, err));
+    EXPECT_FALSE(parse_options({"--raw-columns", "2305843009213693952"}, err));
+    EXPECT_FALSE(parse_options({"--raw-columns", "2x"}, err));
+    EXPECT_TRUE(parse_options({"--raw-columns", "1073741824"}, err));
+}
+
+// Test: Comparison server runs client jobs, serves inputs from its cache and notices changed files
+TEST(ComparisonServer, CachedJobs) {
+    std::string socket = (fs::temp_directory_path() / "dn_server_test.sock").string();
+    ComparisonServer server(socket, 1 << 20, 2);
+    std::thread serving([&server] { server.serve(); });
+    std::string dir = fs::temp_directory_path().string();
+    write_temp_file("dn_server1.dat", "# ref\n1.0 2.0\n3.0 4.0\n");
+    write_temp_file("dn_server2.dat", "1.0 2.0\n3.0 4.5\n");
+    std::vector<std::string> args = {"-s", "dn_server1.dat", "dn_server2.dat"};
+
+    int code = 0;
+    std::string out, err;
+    bool connected = false;
+    for (int attempt = 0; attempt < 200 && !connected; ++attempt) {
+        connected = ComparisonServer::request(socket, dir, args, code, out, err);
+        if (!connected) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(connected);
+    EXPECT_EQ(fs::status(socket).permissions() & fs::perms::all, fs::perms::owner_read | fs::perms::owner_write);
+    EXPECT_EQ(code, 1);
+    EXPECT_NE(out.find("Files DIFFER: 1 lines differ"), std::string::npos);
+    EXPECT_EQ(server.cache().misses(), 2u);
+
+    ASSERT_TRUE(ComparisonServer::request(socket, dir, args, code, out, err));
+    EXPECT_EQ(code, 1);
+    EXPECT_EQ(server.cache().hits(), 2u);
+
+    // A modified file is reloaded
+    write_temp_file("dn_server2.dat", "1.0 2.0\n3.0 4.0\n");
+    ASSERT_TRUE(ComparisonServer::request(socket, dir, args, code, out, err));
+    EXPECT_EQ(code, 0);
+    EXPECT_EQ(server.cache().misses(), 3u);
+
+    // Errors are reported back to the client
+    args = {"dn_server1.dat", "dn_missing.dat"};
+    ASSERT_TRUE(ComparisonServer::request(socket, dir, args, code, out, err));
+    EXPECT_EQ(code, -1);
+    EXPECT_NE(err.find("does not exist"), std::string::npos);
+
+    // Option errors are reported back too, not printed by the server
+    args = {"--block-size", "x", "dn_server1.dat", "dn_server2.dat"};
+    ASSERT_TRUE(ComparisonServer::request(socket, dir, args, code, out, err));
+    EXPECT_EQ(code, -1);
+    EXPECT_EQ(err.rfind("Error: Invalid block size 'x'.\n", 0), 0u);
+
+    // Oversized requests are dropped without bringing the server down
+    args = {std::string(1 << 20, 'x'), "dn_server1.dat", "dn_server2.dat"};
+    EXPECT_FALSE(ComparisonServer::request(socket, dir, args, code, out, err));
+    args = {"-s", "dn_server1.dat", "dn_server2.dat"};
+    ASSERT_TRUE(ComparisonServer::request(socket, dir, args, code, out, err));
+    EXPECT_EQ(code, 0);
+
+    server.stop();
+    serving.join();
+    EXPECT_FALSE(fs::exists(socket));
+}
+
+// Test: Clients that connect and then stall are dropped after the I/O timeout instead of holding workers
+TEST(ComparisonServer, DropsStalledClients) {
+    std::string socket = (fs::temp_directory_path() / "dn_server_stall.sock").string();
+    ComparisonServer server(socket, 1 << 20, 2, 100);
+    std::thread serving([&server] { server.serve(); });
+    std::string dir = fs::temp_directory_path().string();
+    write_temp_file("dn_stall1.dat", "1.0 2.0\n");
+    write_temp_file("dn_stall2.dat", "1.0 2.0\n");
+    std::vector<std::string> args = {"-s", "dn_stall1.dat", "dn_stall2.dat"};
+    int code = -1;
+    std::string out, err;
+    bool connected = false;
+    for (int attempt = 0; attempt < 200 && !connected; ++attempt) {
+        connected = ComparisonServer::request(socket, dir, args, code, out, err);
+        if (!connected) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(connected);
+
+    // One stalled client per worker: the next request only runs once they time out
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket.c_str());
+    std::vector<int> stalled;
+    for (int i = 0; i < 2; ++i) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+        stalled.push_back(fd);
+    }
+    code = -1;
+    EXPECT_TRUE(ComparisonServer::request(socket, dir, args, code, out, err));
+    EXPECT_EQ(code, 0);
+    for (int fd : stalled) ::close(fd);
+
+    server.stop();
+    serving.join();
+}
+
+// Test: an exception thrown by a pool task is rethrown by wait(), and the pool stays usable
+TEST(ThreadPool, RethrowsTaskExceptions) {
+    ThreadPool pool(2);
+    std::atomic<int> done{0};
+    pool.submit([] { throw std::runtime_error("task failed"); });
+    pool.submit([&done] { ++done; });
+    EXPECT_THROW(pool.wait(), std::runtime_error);
+    EXPECT_EQ(done.load(), 1);
+    pool.submit([&done] { ++done; });
+    EXPECT_NO_THROW(pool.wait());
+    EXPECT_EQ(done.load(), 2);
+}
+
+// Test: --profile counts lines, tokens, parses and cells equal as text without changing the result
+TEST(Profiler, CountsPhasesAndThroughput) {
+    std::string file1 = write_temp_file("dn_profile1.dat", "# header\n1.0 2.0 a\n3.0 4.0 b\n5.0 6.0 c\n");
+    std::string file2 = write_temp_file("dn_profile2.dat", "1.0 2.0 a\n3.0 4.5 b\n5.0 6.0 c\n");
+    NumericDiffOption opts;
+    opts.file1 = file1;
+    opts.file2 = file2;
+    opts.only_equal = true;
+    Profiler profiler;
+    NumericDiff diff(opts);
+    diff.setProfiler(&profiler);
+    testing::internal::CaptureStdout();
+    profiler.start();
+    EXPECT_EQ(diff.run(), 1);
+    profiler.stop();
+    testing::internal::GetCapturedStdout();
+    EXPECT_EQ(profiler.lines(), 3u);
+    EXPECT_EQ(profiler.tokens(), 18u);
+    // Only the one pair of cells whose text differs is parsed
+    EXPECT_EQ(profiler.parses(), 2u);
+    EXPECT_EQ(profiler.fastPathCells(), 8u);
+    EXPECT_EQ(diff.fastPathCells(), 8u);
+    EXPECT_EQ(profiler.bytes(), 9u + 3 * 10u + 3 * 10u);
+
+    std::ostringstream json;
+    profiler.report(json, true);
+    EXPECT_NE(json.str().find("\"lines\": 3,"), std::string::npos);
+    EXPECT_NE(json.str().find("\"tokenize\": {\"wall_s\": "), std::string::npos);
+    EXPECT_NE(json.str().find("\"heap_allocations\": null"), std::string::npos);
+}
+
+// Test: StyledLine keeps highlights apart from the text and closes them at the cut
+TEST(StyledLine, WritesHighlightsOnlyWithColor) {
+    StyledLine line;
+    line.append("1.0");
+    line.append(" ");
+    line.append("2.5", true);
+    line.pad(2);
+    EXPECT_EQ(line.width(), 9u);
+    EXPECT_TRUE(line.highlighted());
+    std::ostringstream plain, colored, cut;
+    line.write(plain, false);
+    line.write(colored, true);
+    line.write(cut, true, 5);
+    EXPECT_EQ(plain.str(), "1.0 2.5  ");
+    EXPECT_EQ(colored.str(), "1.0 \033[31m2.5\033[0m  ");
+    EXPECT_EQ(cut.str(), "1.0 \033[31m2\033[0m");
+}
+
+// Test: Colors follow --color; output that is not a terminal gets none by default
+TEST(DiffNumerics, ColorModes) {
+    NumericDiffOption opts;
+    opts.file1 = test_data_path("delta_3P2-3F2.dat");
+    opts.file2 = test_data_path("delta_3P2-3F2_2.dat");
+    opts.side_by_side = true;
+    opts.suppress_common_lines = true;
+    testing::internal::CaptureStdout();
+    NumericDiff(opts).run();
+    std::string automatic = testing::internal::GetCapturedStdout();
+    opts.color = "always";
+    testing::internal::CaptureStdout();
+    NumericDiff(opts).run();
+    std::string always = testing::internal::GetCapturedStdout();
+    EXPECT_EQ(automatic.find('\033'), std::string::npos);
+    EXPECT_NE(automatic.find("   |   "), std::string::npos);
+    EXPECT_NE(always.find("\033[31m"), std::string::npos);
+}
+
+// Helper: stream buffer that discards everything written to it, without allocating
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Test: Steady-state comparison makes no heap allocations: a run over twice as many
+// lines allocates exactly as much as a run over the first half
+TEST(DiffNumerics, NoAllocationsPerLine) {
+    auto make_data = [](size_t lines, bool changed) {
+        std::string data = "# x y label z\n";
+        for (size_t i = 0; i < lines; ++i) {
+            bool differs = changed && i % 5 == 0;
+            data += std::to_string(i % 7) + ".5 " + (differs ? "2.5e-3" : "2.0e-3") + " x 4.25\n";
+        }
+        return data;
+    };
+    const std::string half1 = make_data(1000, false), half2 = make_data(1000, true);
+    const std::string full1 = make_data(2000, false), full2 = make_data(2000, true);
+    NullBuffer buffer;
+    std::ostream null_out(&buffer);
+
+    std::vector<std::vector<std::string>> modes = {
+        {}, {"-y"}, {"-y", "-d"}, {"-ys"}, {"-s"}, {"-d", "-C", "2,4"}};
+    for (const auto& mode : modes) {
+        std::vector<std::string> args = {"diff-numerics", "--color", "always"};
+        args.insert(args.end(), mode.begin(), mode.end());
+        args.insert(args.end(), {"dn_alloc1.dat", "dn_alloc2.dat"});
+        std::vector<char*> argv;
+        for (auto& arg : args) argv.push_back(&arg[0]);
+        NumericDiffOption opts;
+        ASSERT_TRUE(opts.parse(static_cast<int>(argv.size()), argv.data()));
+
+        auto count_allocations = [&](const std::string& data1, const std::string& data2) {
+            NumericDiff diff(opts);
+            diff.setOutput(null_out, null_out);
+            diff.setInputData(data1, data2);
+            size_t before = g_heap_allocations.load();
+            EXPECT_GT(diff.run(), 0);
+            return g_heap_allocations.load() - before;
+        };
+        EXPECT_EQ(count_allocations(full1, full2), count_allocations(half1, half2))
+            << "mode " << (mode.empty() ? "default" : mode[0]);
+    }
+}
+
+// Test: --format jsonl/csv writes one record per differing cell, caps them and ends with a summary
+TEST(DiffNumerics, MachineReadableRecords) {
+    std::string file1 = write_temp_file("dn_records1.dat", "# a b c\n1.0 2.0 3.0\n4.0 5.0 6.0\n7.0 8.0 9.0\n");
+    std::string file2 = write_temp_file("dn_records2.dat", "1.0 2.5 3.0\n4.0 5.0 6.0\n7.0 8.0 10.0\n");
+    NumericDiffOption opts;
+    opts.file1 = file1;
+    opts.file2 = file2;
+    opts.output_format = "jsonl";
+    opts.side_by_side = true;  // Ignored by record output
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(NumericDiff(opts).run(), 2);
+    std::string jsonl = testing::internal::GetCapturedStdout();
+    EXPECT_NE(jsonl.find("{\"type\":\"cell\",\"line\":1,\"column\":2,\"value1\":2,\"value2\":2.5,\"percent_error\":20}\n"),
+              std::string::npos);
+    EXPECT_NE(jsonl.find("{\"type\":\"cell\",\"line\":3,\"column\":3,\"value1\":9,\"value2\":10,\"percent_error\":10}\n"),
+              std::string::npos);
+    EXPECT_NE(jsonl.find("\"lines\":3,\"differing_lines\":2,\"max_percent_error\":20,\"records\":2,"
+                         "\"dropped_records\":0,\"truncated\":false}\n"),
+              std::string::npos);
+
+    opts.output_format = "csv";
+    opts.columns_to_compare = {3};
+    opts.max_records = 1;
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(NumericDiff(opts).run(), 1);
+    opts.columns_to_compare.clear();
+    EXPECT_EQ(NumericDiff(opts).run(), 2);
+    std::string csv = testing::internal::GetCapturedStdout();
+    const std::string csv_header = "type,line,column,value1,value2,percent_error,file1,file2,lines,"
+                                   "differing_lines,max_percent_error,records,dropped_records,truncated\n";
+    EXPECT_EQ(csv, csv_header + "cell,3,3,9,10,10,,,,,,,,\n" +
+                       "summary,,,,,," + file1 + "," + file2 + ",3,1,10,1,0,false\n" + csv_header +
+                       "cell,1,2,2,2.5,20,,,,,,,,\n" + "summary,,,,,," + file1 + "," + file2 + ",3,2,20,1,1,true\n");
+
+    // Block mode numbers lines like line mode: blank separators are data lines too
+    std::string blocks1 = write_temp_file("dn_records_b1.dat", "1.0 2.0\n3.0 4.0\n\n5.0 6.0\n7.0 8.0\n");
+    std::string blocks2 = write_temp_file("dn_records_b2.dat", "1.0 2.0\n3.0 4.0\n\n5.0 6.0\n7.0 9.0\n");
+    opts.file1 = blocks1;
+    opts.file2 = blocks2;
+    opts.output_format = "jsonl";
+    opts.max_records = 0;
+    std::string line_mode;
+    for (bool blocks : {false, true}) {
+        opts.blocks = blocks;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(NumericDiff(opts).run(), 1);
+        jsonl = testing::internal::GetCapturedStdout();
+        EXPECT_NE(jsonl.find("{\"type\":\"cell\",\"line\":5,\"column\":2,"), std::string::npos) << jsonl;
+        EXPECT_NE(jsonl.find("\"lines\":5,\"differing_lines\":1,"), std::string::npos) << jsonl;
+        if (!blocks) line_mode = jsonl;
+    }
+    EXPECT_EQ(jsonl, line_mode);
+}
+
+// Test: --column-policy/--policy-file apply abs, ulp and exact rules per column, with -C projection
+TEST(DiffNumerics, PerColumnPolicies) {
+    std::string file1 = write_temp_file("dn_policy1.dat", "1.0 1.0 5.0 100\n2.0 1.0 5.0 1\n1.0 1.0 5.0 1\n");
+    std::string file2 =
+        write_temp_file("dn_policy2.dat", "1.0005 1.0000000000000004 5.0 100\n2.0 1.00000000001 5.000000001 1\n"
+                                          "1.01 1.0 5.0 1\n");
+    NumericDiffOption opts;
+    opts.file1 = file1;
+    opts.file2 = file2;
+    opts.output_format = "csv";
+    // Column 1 within 1e-3, column 2 within 4 ULPs, column 3 bit-exact, column 4 default -t
+    opts.column_policies = {"1:abs:1e-3", "2:ulp:4", "3:exact"};
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(NumericDiff(opts).run(), 2);
+    std::string csv = testing::internal::GetCapturedStdout();
+    EXPECT_EQ(csv.find("\ncell,1,"), std::string::npos);
+    EXPECT_NE(csv.find("\ncell,2,2,1,1.00000000001,"), std::string::npos);
+    EXPECT_NE(csv.find("\ncell,2,3,5,5.000000001,"), std::string::npos);
+    EXPECT_NE(csv.find("\ncell,3,1,1,1.01,"), std::string::npos);
+
+    // Same rules from a policy file, with -C projection; later rules win
+    opts.column_policies = {"1:rel:10"};
+    opts.policy_file = write_temp_file("dn_policy.txt", "# column mode tolerance\n1 abs 1e-3\n2:ulp:4\n3 exact\n");
+    opts.columns_to_compare = {1, 3};
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(NumericDiff(opts).run(), 1);
+    csv = testing::internal::GetCapturedStdout();
+    EXPECT_NE(csv.find("\ncell,2,3,5,5.000000001,"), std::string::npos);
+    EXPECT_EQ(csv.find("\ncell,3,1,"), std::string::npos);
+
+    std::ostringstream out, err;
+    opts.policy_file = write_temp_file("dn_policy_bad.txt", "2 ulp\n");
+    NumericDiff bad(opts);
+    bad.setOutput(out, err);
+    EXPECT_EQ(bad.run(), -1);
+    EXPECT_NE(err.str().find("needs a tolerance"), std::string::npos);
+    EXPECT_EQ(out.str(), "");  // No CSV header before the error
+}
+
+// Test: ColumnPolicy::differs on signed zeros, values either side of zero and NaN
+TEST(ColumnPolicy, SignedZerosAndNaN) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double denorm = std::numeric_limits<double>::denorm_min();
+    double error = 0.0;
+    for (auto mode : {ColumnPolicy::Mode::Absolute, ColumnPolicy::Mode::Ulp, ColumnPolicy::Mode::Exact}) {
+        ColumnPolicy policy;
+        policy.mode = mode;
+        policy.tolerance = 0.0;
+        policy.threshold = 0.0;
+        SCOPED_TRACE(static_cast<int>(mode));
+        EXPECT_FALSE(policy.differs(-0.0, 0.0, error));
+        EXPECT_FALSE(policy.differs(nan, nan, error));
+        EXPECT_FALSE(policy.differs(-nan, nan, error));
+        EXPECT_TRUE(policy.differs(nan, 0.0, error));
+        EXPECT_TRUE(policy.differs(1.0, nan, error));
+        EXPECT_TRUE(policy.differs(-denorm, denorm, error));
+        EXPECT_TRUE(policy.differs(-1.0, 1.0, error));
+    }
+
+    // The ULP distance counts through zero: -denorm, -0.0 = 0.0, denorm
+    EXPECT_EQ(ColumnPolicy::ulpDistance(-0.0, 0.0), 0u);
+    EXPECT_EQ(ColumnPolicy::ulpDistance(-denorm, denorm), 2u);
+    EXPECT_EQ(ColumnPolicy::ulpDistance(-denorm, 0.0), 1u);
+    ColumnPolicy ulp;
+    ulp.mode = ColumnPolicy::Mode::Ulp;
+    ulp.threshold = 0.0;
+    ulp.tolerance = 2.0;
+    EXPECT_FALSE(ulp.differs(-denorm, denorm, error));
+    ulp.tolerance = 1.0;
+    EXPECT_TRUE(ulp.differs(-denorm, denorm, error));
+    EXPECT_FALSE(ulp.differs(-denorm, -0.0, error));
+
+    // Either side of zero but both below the threshold: equal except in exact mode
+    ColumnPolicy below;
+    below.tolerance = 0.0;
+    below.threshold = 1e-6;
+    for (auto mode : {ColumnPolicy::Mode::Absolute, ColumnPolicy::Mode::Ulp}) {
+        below.mode = mode;
+        EXPECT_FALSE(below.differs(-1e-9, 1e-9, error));
+    }
+    below.mode = ColumnPolicy::Mode::Exact;
+    EXPECT_TRUE(below.differs(-1e-9, 1e-9, error));
+}
+
+// Test: --progress prints a final report on stderr, and intermediate reports with share done and ETA
+TEST(DiffNumerics, ProgressReport) {
+    NumericDiffOption opts;
+    opts.file1 = "a.dat";
+    opts.file2 = "b.dat";
+    opts.only_equal = true;
+    opts.progress = true;
+    std::ostringstream out, err;
+    NumericDiff diff(opts);
+    diff.setOutput(out, err);
+    diff.setInputData("1.0 2.0\n3.0 4.0\n5.0 6.0\n", "1.0 2.0\n3.0 4.5\n5.0 6.0\n");
+    EXPECT_EQ(diff.run(), 1);
+    // Short inputs never reach a checkpoint: only the final report is printed
+    std::string report = err.str();
+    EXPECT_EQ(report.rfind("Progress: 0.0 MB, 3 lines, ", 0), 0u);
+    EXPECT_NE(report.find(" MB/s, 1 differing lines, done in "), std::string::npos);
+    EXPECT_EQ(std::count(report.begin(), report.end(), '\n'), 1);
+
+    // Intermediate reports show the share of the input done and the time left
+    std::ostringstream os;
+    Progress progress(os, 4000000, true, 0.0);
+    progress.update(1000000, 10, 2);
+    EXPECT_EQ(os.str().rfind("\rProgress: 1.0 MB of 4.0 MB (25%), 10 lines, ", 0), 0u);
+    EXPECT_NE(os.str().find(", 2 differing lines, ETA "), std::string::npos);
+    progress.finish(4000000, 40, 3);
+    EXPECT_NE(os.str().find("\rProgress: 4.0 MB, 40 lines, "), std::string::npos);
+    EXPECT_EQ(os.str().back(), '\n');
+}
+
+// Test: cells with identical text are equal without being parsed, in line and block mode
+TEST(DiffNumerics, LexicalFastPath) {
+    NumericDiffOption opts;
+    opts.file1 = "a.dat";
+    opts.file2 = "b.dat";
+    opts.only_equal = true;
+    std::string data1 = "0.5 0.0000000000000000 nan x\n1.0 2.0 3.0 y\n\n4.0 5.0 6.0 z\n";
+    std::string data2 = "0.5 0.0000000000000000 nan x\n1.00 2.0 3.5 y\n\n4.0 5.0 6.0 z\n";
+    std::ostringstream out, err;
+    NumericDiff diff(opts);
+    diff.setOutput(out, err);
+    diff.setInputData(data1, data2);
+    EXPECT_EQ(diff.run(), 1);
+    // 1.0 and 1.00 differ as text but are equal numbers; only 3.0 / 3.5 differs
+    EXPECT_EQ(diff.fastPathCells(), 10u);
+
+    opts.blocks = true;
+    opts.jobs = 2;
+    NumericDiff blocks(opts);
+    blocks.setOutput(out, err);
+    blocks.setInputData(data1, data2);
+    EXPECT_EQ(blocks.run(), 1);
+    EXPECT_EQ(blocks.fastPathCells(), 10u);
+}
+
+// Test: parsed inputs (as cached by the comparison server) give the same output as the
+// same text read line by line, in every output mode
+TEST(DiffNumerics, ParsedInputsMatchText) {
+    std::string data1 = "1.0 2.0 abc 4.0\n  0.5\t0.25 1e3 x\n\n7 8 9\n1 2 3 4 5\n";
+    std::string data2 = "1.00 2.5 abd 4.0\n0.5 0.26 1000 x y\n1 2\n7 8\n";
+    std::shared_ptr<const ParsedText> parsed1 = ParsedText::parse(data1);
+    std::shared_ptr<const ParsedText> parsed2 = ParsedText::parse(data2);
+    ASSERT_TRUE(parsed1 && parsed2);
+    EXPECT_EQ(parsed1->lines(), 5u);
+    EXPECT_EQ(parsed1->line(1), "  0.5\t0.25 1e3 x");
+    auto run = [&](const NumericDiffOption& opts, bool parsed, bool profile) {
+        std::ostringstream out, err;
+        NumericDiff diff(opts);
+        diff.setOutput(out, err);
+        if (parsed) {
+            diff.setParsedInputs(*parsed1, *parsed2);
+        } else {
+            diff.setInputData(data1, data2);
+        }
+        Profiler profiler;
+        if (profile) diff.setProfiler(&profiler);
+        int code = diff.run();
+        return std::to_string(code) + "\n" + out.str() + err.str();
+    };
+    NumericDiffOption base;
+    base.file1 = "a.dat";
+    base.file2 = "b.dat";
+    base.color = "always";
+    for (int mode = 0; mode < 7; ++mode) {
+        NumericDiffOption opts = base;
+        opts.side_by_side = mode == 1 || mode == 2;
+        opts.suppress_common_lines = mode == 2;
+        if (mode == 3) opts.columns_to_compare = {2, 3, 5};
+        opts.color_diff_digits = mode == 4;
+        if (mode == 5) opts.output_format = "jsonl";
+        opts.only_equal = mode == 6;
+        for (bool profile : {false, true}) {
+            std::string expected = run(opts, false, profile);
+            EXPECT_EQ(run(opts, true, profile), expected) << "mode " << mode << " profile " << profile;
+            EXPECT_NE(expected.rfind("0\n", 0), 0u) << "mode " << mode;  // Differences found
+        }
+    }
+}